@@ -0,0 +1,195 @@
+#include "SceneGenerator.h"
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+
+// buffered text output (much faster than formatted stream output)
+class ObjWriter
+{
+public:
+	explicit ObjWriter(const std::filesystem::path& filename)
+		:
+	m_file(filename, std::ios::binary)
+	{
+		if (!m_file.is_open())
+			throw std::runtime_error("could not create " + filename.string());
+		m_buffer.reserve(s_bufferSize + 256);
+	}
+
+	~ObjWriter()
+	{
+		flush();
+	}
+
+	template<class... T>
+	void line(const char* format, T... args)
+	{
+		char text[256];
+		const int count = std::snprintf(text, sizeof(text), format, args...);
+		m_buffer.insert(m_buffer.end(), text, text + std::min(count, int(sizeof(text)) - 1));
+		m_buffer.push_back('\n');
+		if (m_buffer.size() >= s_bufferSize) flush();
+	}
+
+	void flush()
+	{
+		m_file.write(m_buffer.data(), std::streamsize(m_buffer.size()));
+		m_written += m_buffer.size();
+		m_buffer.clear();
+	}
+
+	uint64_t getWritten() const { return m_written + m_buffer.size(); }
+private:
+	static constexpr size_t s_bufferSize = 1 << 20;
+	std::ofstream m_file;
+	std::vector<char> m_buffer;
+	uint64_t m_written = 0;
+};
+
+SceneGenerator::Result SceneGenerator::generate(const Settings& settings, const std::filesystem::path& directory, const std::string& name)
+{
+	std::filesystem::create_directories(directory);
+	const auto numShapes = std::max<size_t>(settings.numShapes, 1);
+	const auto numMaterials = std::max<size_t>(settings.numMaterials, 1);
+	// quads per side of each grid
+	const auto gridSize = std::max<size_t>(size_t(std::sqrt(double(settings.numTriangles) / double(numShapes) / 2.0)), 1);
+
+	Result res;
+	res.obj = directory / (name + ".obj");
+	std::mt19937 rng(settings.seed);
+	std::uniform_real_distribution<float> random(0.0f, 1.0f);
+
+	// materials
+	{
+		ObjWriter mtl(directory / (name + ".mtl"));
+		for(size_t m = 0; m < numMaterials; ++m)
+		{
+			mtl.line("newmtl material%zu", m);
+			mtl.line("Kd %.3f %.3f %.3f", random(rng), random(rng), random(rng));
+			mtl.line("Ks 0.04 0.04 0.04");
+			mtl.line("Ns %d", 10 + int(random(rng) * 200.0f));
+			if(settings.textureSize > 0)
+			{
+				const bool alpha = settings.alphaTextures && m % 4 == 3;
+				const auto texName = name + "_tex" + std::to_string(m) + ".tga";
+				writeTexture(directory / texName, settings.textureSize, settings.seed + uint32_t(m), alpha);
+				res.numBytes += std::filesystem::file_size(directory / texName);
+				mtl.line("map_Kd %s", texName.c_str());
+				if (alpha) mtl.line("map_d %s", texName.c_str());
+			}
+			mtl.line("");
+		}
+		mtl.flush();
+		res.numBytes += mtl.getWritten();
+	}
+
+	ObjWriter obj(res.obj);
+	obj.line("# generated scene: %zu shapes with %zux%zu quads", numShapes, gridSize, gridSize);
+	obj.line("mtllib %s.mtl", name.c_str());
+
+	const size_t vertsPerSide = gridSize + 1;
+	const size_t vertsPerShape = vertsPerSide * vertsPerSide;
+	// shapes are placed on a square grid
+	const auto shapesPerRow = size_t(std::ceil(std::sqrt(double(numShapes))));
+	for(size_t s = 0; s < numShapes; ++s)
+	{
+		obj.line("o shape%zu", s);
+		const float originX = float(s % shapesPerRow) * 1.1f;
+		const float originZ = float(s / shapesPerRow) * 1.1f;
+		const float frequency = 2.0f + random(rng) * 6.0f;
+		const float amplitude = 0.02f + random(rng) * 0.1f;
+
+		for(size_t y = 0; y < vertsPerSide; ++y)
+		{
+			for(size_t x = 0; x < vertsPerSide; ++x)
+			{
+				const float u = float(x) / float(gridSize);
+				const float v = float(y) / float(gridSize);
+				const float height = amplitude * std::sin(u * frequency) * std::cos(v * frequency);
+				obj.line("v %.6f %.6f %.6f", originX + u, height, originZ + v);
+				if(settings.normals)
+				{
+					// derivative of the height function
+					const float dx = amplitude * frequency * std::cos(u * frequency) * std::cos(v * frequency);
+					const float dz = -amplitude * frequency * std::sin(u * frequency) * std::sin(v * frequency);
+					const float len = std::sqrt(dx * dx + 1.0f + dz * dz);
+					obj.line("vn %.5f %.5f %.5f", -dx / len, 1.0f / len, -dz / len);
+				}
+				if (settings.texcoords)
+					obj.line("vt %.5f %.5f", u, v);
+			}
+		}
+
+		// relative indices => independent of the previous shapes
+		auto index = [&](size_t x, size_t y) { return -int64_t(vertsPerShape - (y * vertsPerSide + x)); };
+		auto corner = [&](int64_t i)
+		{
+			std::string res = std::to_string(i);
+			if (settings.texcoords && settings.normals) res += "/" + res + "/" + res;
+			else if (settings.texcoords) res += "/" + res;
+			else if (settings.normals) res += "//" + res;
+			return res;
+		};
+
+		size_t material = s % numMaterials;
+		obj.line("usemtl material%zu", material);
+		for(size_t y = 0; y < gridSize; ++y)
+		{
+			for(size_t x = 0; x < gridSize; ++x)
+			{
+				if(settings.interleaveMaterials && (y * gridSize + x) % 16 == 15)
+				{
+					material = (material + 1) % numMaterials;
+					obj.line("usemtl material%zu", material);
+				}
+				obj.line("f %s %s %s %s", corner(index(x, y)).c_str(), corner(index(x + 1, y)).c_str(),
+					corner(index(x + 1, y + 1)).c_str(), corner(index(x, y + 1)).c_str());
+			}
+		}
+		res.numVertices += vertsPerShape;
+		res.numTriangles += gridSize * gridSize * 2;
+	}
+	obj.flush();
+	res.numBytes += obj.getWritten();
+	return res;
+}
+
+void SceneGenerator::writeTexture(const std::filesystem::path& filename, int size, uint32_t seed, bool alpha)
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("could not create " + filename.string());
+
+	// uncompressed true color, origin at the top left
+	uint8_t header[18] = {};
+	header[2] = 2;
+	header[12] = uint8_t(size & 0xFF);
+	header[13] = uint8_t(size >> 8);
+	header[14] = uint8_t(size & 0xFF);
+	header[15] = uint8_t(size >> 8);
+	header[16] = 32;
+	header[17] = 8 | 32;
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	// checker board with a seed dependent tint (bgra)
+	const uint8_t tint[3] = { uint8_t(seed * 67), uint8_t(seed * 131), uint8_t(seed * 29) };
+	const int cell = std::max(size / 8, 1);
+	std::vector<uint8_t> row(size_t(size) * 4);
+	for(int y = 0; y < size; ++y)
+	{
+		for(int x = 0; x < size; ++x)
+		{
+			const bool dark = ((x / cell) + (y / cell)) % 2 != 0;
+			uint8_t* p = row.data() + size_t(x) * 4;
+			for (int c = 0; c < 3; ++c)
+				p[c] = dark ? uint8_t(tint[c] / 2) : uint8_t(128 + tint[c] / 2);
+			// binary alpha => alpha tested
+			p[3] = alpha && dark ? 0 : 255;
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), std::streamsize(row.size()));
+	}
+}
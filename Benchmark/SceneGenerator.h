@@ -0,0 +1,41 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <cstdint>
+
+// writes procedural obj/mtl scenes for benchmarks. Every shape is a displaced grid of quads (two triangles each)
+class SceneGenerator
+{
+public:
+	struct Settings
+	{
+		// approximate number of triangles (rounded to full grids)
+		size_t numTriangles = 1000000;
+		size_t numShapes = 64;
+		size_t numMaterials = 8;
+		// switch the material every few faces inside of the shapes instead of once per shape
+		bool interleaveMaterials = false;
+		bool normals = true;
+		bool texcoords = true;
+		// every material gets an albedo texture of this size (0 = no textures)
+		int textureSize = 0;
+		// some materials get an alpha channel in their albedo texture (=> alpha tested / transparent meshes)
+		bool alphaTextures = false;
+		uint32_t seed = 1;
+	};
+
+	struct Result
+	{
+		std::filesystem::path obj;
+		size_t numTriangles = 0;
+		size_t numVertices = 0;
+		// obj + mtl + textures
+		uint64_t numBytes = 0;
+	};
+
+	/// \brief writes <directory>/<name>.obj, <name>.mtl and the textures. throws on errors
+	static Result generate(const Settings& settings, const std::filesystem::path& directory, const std::string& name);
+
+	/// \brief writes an uncompressed 32 bit tga with a procedural pattern
+	static void writeTexture(const std::filesystem::path& filename, int size, uint32_t seed, bool alpha);
+};
@@ -0,0 +1,220 @@
+#include <iostream>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <map>
+#include "../ObjSingleIndexBufferConverter/ArgumentSet.h"
+#include "../ObjSingleIndexBufferConverter/Converter.h"
+#include "../ObjSingleIndexBufferConverter/Console.h"
+#include "../ObjSingleIndexBufferConverter/Profiler.h"
+#include "../json/single_include/nlohmann/json.hpp"
+#include "SceneGenerator.h"
+
+// converts procedural scenes and reports the duration of every converter stage.
+// params:
+// -out results.json => machine readable results (default benchmark.json)
+// -dir path => directory for the generated scenes and the converted output (default <temp>/hrsf_benchmark)
+// -scale S => multiplies the triangle counts of all scenarios (default 1)
+// -repeat N => converts every scene N times and keeps the fastest run (default 1)
+// -filter name1 name2 ... => only runs scenarios whose name contains one of the strings (fails if none matches)
+// -compare old.json [-tolerance P] => fails if a scenario got more than P percent slower (default 10)
+// -verbose => prints the converter output
+
+using json = nlohmann::json;
+
+struct Scenario
+{
+	std::string name;
+	SceneGenerator::Settings settings;
+	// textures are only converted if the scene has some
+	bool convertTextures = false;
+};
+
+static std::vector<Scenario> getScenarios(double scale)
+{
+	std::vector<Scenario> res;
+	auto add = [&](const char* name, auto modify, bool textures = false)
+	{
+		Scenario s;
+		s.name = name;
+		modify(s.settings);
+		s.settings.numTriangles = std::max<size_t>(size_t(double(s.settings.numTriangles) * scale), 2);
+		s.convertTextures = textures;
+		res.push_back(std::move(s));
+	};
+
+	add("baseline", [](SceneGenerator::Settings&) {});
+	add("few_shapes", [](SceneGenerator::Settings& s) { s.numShapes = 4; });
+	add("many_shapes", [](SceneGenerator::Settings& s) { s.numShapes = 4096; });
+	add("many_materials", [](SceneGenerator::Settings& s) { s.numMaterials = 256; });
+	add("interleaved_materials", [](SceneGenerator::Settings& s) { s.interleaveMaterials = true; });
+	add("no_normals", [](SceneGenerator::Settings& s) { s.normals = false; });
+	add("no_texcoords", [](SceneGenerator::Settings& s) { s.texcoords = false; });
+	add("positions_only", [](SceneGenerator::Settings& s) { s.normals = false; s.texcoords = false; });
+	add("textured", [](SceneGenerator::Settings& s)
+	{
+		s.numMaterials = 16;
+		s.textureSize = 512;
+		s.alphaTextures = true;
+	}, true);
+	return res;
+}
+
+static double getMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static json runScenario(const Scenario& scenario, const std::filesystem::path& directory, int repeat)
+{
+	const auto sceneDir = directory / scenario.name;
+	std::filesystem::remove_all(sceneDir);
+
+	auto start = std::chrono::steady_clock::now();
+	const auto scene = SceneGenerator::generate(scenario.settings, sceneDir, "scene");
+	const auto generateMs = getMs(start);
+
+	json best;
+	double bestMs = 0.0;
+	for(int i = 0; i < repeat; ++i)
+	{
+		// the texture cache would skip the textures of the previous run
+		const auto outDir = sceneDir / "out";
+		std::filesystem::remove_all(outDir);
+		std::filesystem::create_directories(outDir);
+
+		Profiler::reset();
+		start = std::chrono::steady_clock::now();
+		{
+			Converter converter;
+			converter.GenerateTextures = scenario.convertTextures;
+			converter.convert(scene.obj, outDir / "scene");
+		}
+		const auto totalMs = getMs(start);
+		if (i > 0 && totalMs >= bestMs) continue;
+
+		bestMs = totalMs;
+		json stages = json::array();
+		for(const auto& s : Profiler::getStages())
+		{
+			stages.push_back({
+				{ "name", s.name }, { "ms", s.totalMs }, { "count", s.count },
+				{ "peakMemoryMB", double(s.peakMemory) / (1024.0 * 1024.0) }
+			});
+		}
+
+		const double seconds = totalMs / 1000.0;
+		best = {
+			{ "name", scenario.name },
+			{ "settings", {
+				{ "triangles", scenario.settings.numTriangles }, { "shapes", scenario.settings.numShapes },
+				{ "materials", scenario.settings.numMaterials }, { "interleaveMaterials", scenario.settings.interleaveMaterials },
+				{ "normals", scenario.settings.normals }, { "texcoords", scenario.settings.texcoords },
+				{ "textureSize", scenario.settings.textureSize }, { "alphaTextures", scenario.settings.alphaTextures }
+			} },
+			{ "triangles", scene.numTriangles },
+			{ "vertices", scene.numVertices },
+			{ "inputMB", double(scene.numBytes) / (1024.0 * 1024.0) },
+			{ "generateMs", generateMs },
+			{ "totalMs", totalMs },
+			{ "trianglesPerSecond", double(scene.numTriangles) / seconds },
+			{ "mbPerSecond", double(scene.numBytes) / (1024.0 * 1024.0) / seconds },
+			// the peak of the whole process (includes the previous scenarios)
+			{ "peakMemoryMB", double(Profiler::getPeakMemory()) / (1024.0 * 1024.0) },
+			{ "stages", stages }
+		};
+	}
+	return best;
+}
+
+// compares the total times with previous results
+// \return number of regressions
+static size_t compare(const json& results, const std::filesystem::path& filename, double tolerance)
+{
+	std::ifstream file(filename);
+	if (!file.is_open())
+		throw std::runtime_error("could not open " + filename.string());
+	json old;
+	file >> old;
+
+	std::map<std::string, double> oldTimes;
+	for (const auto& r : old.at("results"))
+		oldTimes[r.at("name").get<std::string>()] = r.at("totalMs").get<double>();
+
+	size_t regressions = 0;
+	for(const auto& r : results)
+	{
+		const auto it = oldTimes.find(r.at("name").get<std::string>());
+		if (it == oldTimes.end() || it->second <= 0.0) continue;
+		const auto change = (r.at("totalMs").get<double>() / it->second - 1.0) * 100.0;
+		const bool regressed = change > tolerance;
+		if (regressed) ++regressions;
+		std::cout << (regressed ? "REGRESSION " : "") << r.at("name").get<std::string>() << ": " << (change >= 0.0 ? "+" : "") << change << "%\n";
+	}
+	return regressions;
+}
+
+int main(int argc, char** argv) try
+{
+	util::ArgumentSet args;
+	args.init(argc - 1, argv + 1);
+
+	const auto outFile = args.get<std::string>("out", "benchmark.json");
+	const auto directory = args.has("dir") ? std::filesystem::path(args.get<std::string>("dir", "")) : std::filesystem::temp_directory_path() / "hrsf_benchmark";
+	const auto scale = args.get<double>("scale", 1.0);
+	const auto repeat = std::max(args.get<int>("repeat", 1), 1);
+	const auto filters = args.getVector<std::string>("filter");
+	// a bare -filter is stored as "true"
+	if (args.has("filter") && (filters.empty() || (filters.size() == 1 && filters[0] == "true")))
+		throw std::runtime_error("-filter expects at least one scenario name");
+
+	if(!args.has("verbose"))
+	{
+		Console::PrintInfo = false;
+		Console::PrintWarning = false;
+	}
+	Profiler::setEnabled(true);
+
+	std::vector<Scenario> scenarios;
+	std::string available;
+	for(auto& scenario : getScenarios(scale))
+	{
+		available += (available.empty() ? "" : ", ") + scenario.name;
+		if (!filters.empty() && std::none_of(filters.begin(), filters.end(), [&](const std::string& f) { return scenario.name.find(f) != std::string::npos; }))
+			continue;
+		scenarios.push_back(std::move(scenario));
+	}
+	if (scenarios.empty())
+		throw std::runtime_error("no scenario matches the filter (available: " + available + ")");
+
+	json results = json::array();
+	for(const auto& scenario : scenarios)
+	{
+		std::cout << scenario.name << ": " << std::flush;
+		auto r = runScenario(scenario, directory, repeat);
+		std::cout << int64_t(r.at("totalMs").get<double>()) << " ms, "
+			<< int64_t(r.at("trianglesPerSecond").get<double>() / 1000.0) << "k triangles/s, "
+			<< r.at("mbPerSecond").get<double>() << " MB/s\n";
+		for (const auto& s : r.at("stages"))
+			std::cout << "    " << s.at("name").get<std::string>() << ": " << s.at("ms").get<double>() << " ms\n";
+		results.push_back(std::move(r));
+	}
+
+	std::ofstream file(outFile);
+	if (!file.is_open())
+		throw std::runtime_error("could not write " + outFile);
+	file << json{ { "scale", scale }, { "repeat", repeat }, { "results", results } }.dump(2);
+	std::cout << "wrote " << outFile << "\n";
+
+	if(args.has("compare"))
+	{
+		const auto regressions = compare(results, args.get<std::string>("compare", ""), args.get<double>("tolerance", 10.0));
+		return regressions ? -1 : 0;
+	}
+	return 0;
+}
+catch (const std::exception& e)
+{
+	std::cerr << "ERR: " << e.what() << "\n";
+	return -1;
+}
@@ -0,0 +1,107 @@
+#include "Batch.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "../json/single_include/nlohmann/json.hpp"
+#include "Console.h"
+
+using json = nlohmann::json;
+
+Batch::Batch(const std::filesystem::path& manifest)
+{
+	std::ifstream file(manifest);
+	if (!file.is_open())
+		throw std::runtime_error("could not open batch manifest " + manifest.string());
+
+	json j;
+	file >> j;
+
+	const auto root = manifest.parent_path();
+	for(const auto& e : j.at("jobs"))
+	{
+		Job job;
+		job.input = root / std::filesystem::u8path(e.at("input").get<std::string>());
+		job.output = root / std::filesystem::u8path(e.at("output").get<std::string>());
+
+		if(e.contains("flags"))
+			job.flags = parseFlags(e.at("flags"));
+
+		std::error_code ec;
+		job.cost = std::filesystem::file_size(job.input, ec);
+		if (ec) job.cost = 0; // reported by the converter
+
+		m_jobs.push_back(std::move(job));
+	}
+
+	Console::info("loaded " + std::to_string(m_jobs.size()) + " batch jobs from " + manifest.string());
+}
+
+std::vector<std::string> Batch::splitFlags(const std::string& flags)
+{
+	std::vector<std::string> res;
+	std::istringstream stream(flags);
+	std::string flag;
+	while (stream >> flag)
+		res.push_back(flag);
+	return res;
+}
+
+size_t Batch::run(const Configure& configure, size_t numWorkers) const
+{
+	if (numWorkers == 0)
+		numWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+	numWorkers = std::min(numWorkers, m_jobs.size());
+
+	// longest processing time first
+	std::vector<const Job*> order;
+	for (const auto& job : m_jobs)
+		order.push_back(&job);
+	std::stable_sort(order.begin(), order.end(), [](const Job* a, const Job* b) { return a->cost > b->cost; });
+
+	std::atomic<size_t> next = 0;
+	std::atomic<size_t> finished = 0;
+	std::atomic<size_t> failed = 0;
+	auto worker = [&]()
+	{
+		for(size_t i = next++; i < order.size(); i = next++)
+		{
+			if (!runJob(*order[i], configure))
+				++failed;
+			Console::progress("batch jobs", ++finished, order.size());
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < numWorkers; ++i)
+		threads.emplace_back(worker);
+	for (auto& t : threads)
+		t.join();
+
+	Console::info("batch finished: " + std::to_string(order.size() - failed) + " succeeded, " + std::to_string(failed) + " failed");
+	return failed;
+}
+
+bool Batch::runJob(const Job& job, const Configure& configure)
+{
+	try
+	{
+		// argument set expects mutable c strings
+		std::vector<std::string> flags = job.flags;
+		std::vector<char*> argv;
+		for (auto& f : flags)
+			argv.push_back(f.data());
+
+		Converter converter;
+		configure(converter, int(argv.size()), argv.data());
+		converter.convert(job.input, job.output);
+		converter.printStats();
+		return true;
+	}
+	catch(const std::exception& e)
+	{
+		Console::error(job.input.string() + ": " + e.what());
+		return false;
+	}
+}
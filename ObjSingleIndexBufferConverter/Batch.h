@@ -0,0 +1,53 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Converter.h"
+
+// converts multiple obj files in one process (see main.cpp for the manifest format).
+// Converters share the texture caches of their destination directories.
+// Jobs that export textures into the same directory with different texture settings fail
+class Batch
+{
+public:
+	/// \brief applies the command line flags of a job to its converter
+	using Configure = std::function<void(Converter&, int argc, char** argv)>;
+
+	/// \brief loads the job manifest. throws on errors
+	explicit Batch(const std::filesystem::path& manifest);
+
+	/// \brief runs all jobs. Large jobs are started first (longest processing time scheduling)
+	/// \param numWorkers number of jobs that run at the same time (0 = number of cores)
+	/// \return number of failed jobs
+	size_t run(const Configure& configure, size_t numWorkers) const;
+
+	size_t size() const { return m_jobs.size(); }
+
+	/// \brief reads the flags of a job (manifest entry or server request): a single string or an array of strings
+	/// \param flags json value (template => the json header is only needed by the callers)
+	template<class Json>
+	static std::vector<std::string> parseFlags(const Json& flags)
+	{
+		if (flags.is_string())
+			return splitFlags(flags.template get<std::string>());
+		return flags.template get<std::vector<std::string>>();
+	}
+	/// \brief splits the flags at whitespace
+	static std::vector<std::string> splitFlags(const std::string& flags);
+private:
+	struct Job
+	{
+		std::filesystem::path input;
+		std::filesystem::path output;
+		std::vector<std::string> flags;
+		// estimated work (size of the obj file)
+		uint64_t cost = 0;
+	};
+
+	/// \brief converts a single job
+	/// \return false if the conversion failed
+	static bool runJob(const Job& job, const Configure& configure);
+
+	std::vector<Job> m_jobs;
+};
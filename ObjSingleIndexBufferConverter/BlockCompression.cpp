@@ -0,0 +1,472 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <cfloat>
+#include <cstring>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+	// 4x4 pixels stored per channel (structure of arrays) so that the per pixel loops vectorize
+	struct Block
+	{
+		float c[4][16];
+	};
+
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(uint8_t* dst) : m_dst(dst) {}
+
+		void write(uint32_t value, int bits)
+		{
+			for(int b = 0; b < bits; ++b, ++m_pos)
+			{
+				if ((value >> b) & 1)
+					m_dst[m_pos >> 3] |= uint8_t(1 << (m_pos & 7));
+			}
+		}
+	private:
+		uint8_t* m_dst;
+		int m_pos = 0;
+	};
+
+	void loadBlock(const Image& image, int bx, int by, Block& block)
+	{
+		for(int y = 0; y < 4; ++y)
+		{
+			const int py = std::min(by * 4 + y, image.getHeight() - 1);
+			for(int x = 0; x < 4; ++x)
+			{
+				const int px = std::min(bx * 4 + x, image.getWidth() - 1);
+				const auto src = image.getPixel(px, py);
+				for (int c = 0; c < 4; ++c)
+					block.c[c][y * 4 + x] = float(src[c]);
+			}
+		}
+	}
+
+	/// \brief computes two endpoints for the first n channels that span the block colors
+	/// \param e0 endpoint with the larger projection
+	void computeEndpoints(const Block& b, int channels, BlockCompression::Quality quality, float* e0, float* e1)
+	{
+		float minVal[4], maxVal[4], mean[4];
+		for(int c = 0; c < channels; ++c)
+		{
+			minVal[c] = *std::min_element(b.c[c], b.c[c] + 16);
+			maxVal[c] = *std::max_element(b.c[c], b.c[c] + 16);
+			mean[c] = std::accumulate(b.c[c], b.c[c] + 16, 0.0f) / 16.0f;
+		}
+
+		if(quality == BlockCompression::Quality::Fast)
+		{
+			// bounding box with a small inset to reduce the error at the extremes
+			for(int c = 0; c < channels; ++c)
+			{
+				const float inset = (maxVal[c] - minVal[c]) / 16.0f;
+				e0[c] = maxVal[c] - inset;
+				e1[c] = minVal[c] + inset;
+			}
+			return;
+		}
+
+		// covariance matrix
+		float cov[4][4] = {};
+		for(int c0 = 0; c0 < channels; ++c0)
+		{
+			for(int c1 = c0; c1 < channels; ++c1)
+			{
+				float sum = 0.0f;
+				for (int i = 0; i < 16; ++i)
+					sum += (b.c[c0][i] - mean[c0]) * (b.c[c1][i] - mean[c1]);
+				cov[c0][c1] = cov[c1][c0] = sum;
+			}
+		}
+
+		// principal axis with power iteration (start with the bounding box diagonal)
+		float axis[4];
+		for (int c = 0; c < channels; ++c)
+			axis[c] = maxVal[c] - minVal[c];
+		for(int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			for (int r = 0; r < channels; ++r)
+				for (int c = 0; c < channels; ++c)
+					next[r] += cov[r][c] * axis[c];
+
+			float len = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				len += next[c] * next[c];
+			if (len < FLT_EPSILON) break;
+			len = 1.0f / std::sqrt(len);
+			for (int c = 0; c < channels; ++c)
+				axis[c] = next[c] * len;
+		}
+
+		float len = 0.0f;
+		for (int c = 0; c < channels; ++c)
+			len += axis[c] * axis[c];
+		if(len < FLT_EPSILON)
+		{
+			// uniform block
+			std::copy(mean, mean + channels, e0);
+			std::copy(mean, mean + channels, e1);
+			return;
+		}
+		len = 1.0f / std::sqrt(len);
+		for (int c = 0; c < channels; ++c)
+			axis[c] *= len;
+
+		// project pixels onto the axis
+		float minT = FLT_MAX, maxT = -FLT_MAX;
+		for(int i = 0; i < 16; ++i)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				t += (b.c[c][i] - mean[c]) * axis[c];
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+
+		// same inset as the bounding box
+		const float inset = (maxT - minT) / 16.0f;
+		minT += inset;
+		maxT -= inset;
+
+		for(int c = 0; c < channels; ++c)
+		{
+			e0[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+			e1[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+		}
+	}
+
+	/// \brief least squares fit of the endpoints for fixed interpolation weights
+	/// \param t interpolation weight of e1 for each pixel
+	bool refineEndpoints(const Block& b, int channels, const float* t, float* e0, float* e1)
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for(int i = 0; i < 16; ++i)
+		{
+			const float alpha = 1.0f - t[i];
+			const float beta = t[i];
+			aa += alpha * alpha;
+			ab += alpha * beta;
+			bb += beta * beta;
+			for(int c = 0; c < channels; ++c)
+			{
+				ax[c] += alpha * b.c[c][i];
+				bx[c] += beta * b.c[c][i];
+			}
+		}
+
+		const float det = aa * bb - ab * ab;
+		if (std::abs(det) < 1e-4f) return false;
+
+		for(int c = 0; c < channels; ++c)
+		{
+			e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+			e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	uint16_t packRgb565(const float* c)
+	{
+		const auto r = uint16_t(std::lround(c[0] * 31.0f / 255.0f));
+		const auto g = uint16_t(std::lround(c[1] * 63.0f / 255.0f));
+		const auto b = uint16_t(std::lround(c[2] * 31.0f / 255.0f));
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	void unpackRgb565(uint16_t v, float* c)
+	{
+		const int r = (v >> 11) & 31;
+		const int g = (v >> 5) & 63;
+		const int b = v & 31;
+		c[0] = float((r << 3) | (r >> 2));
+		c[1] = float((g << 2) | (g >> 4));
+		c[2] = float((b << 3) | (b >> 2));
+	}
+
+	/// \brief finds the closest palette entry for each pixel
+	/// \return squared error
+	template<int TPaletteSize>
+	float fitIndices(const Block& b, int channels, const float (&palette)[TPaletteSize][4], uint8_t* indices)
+	{
+		float dist[TPaletteSize][16];
+		for(int p = 0; p < TPaletteSize; ++p)
+		{
+			for (int i = 0; i < 16; ++i)
+				dist[p][i] = 0.0f;
+			for(int c = 0; c < channels; ++c)
+			{
+				for(int i = 0; i < 16; ++i)
+				{
+					const float d = b.c[c][i] - palette[p][c];
+					dist[p][i] += d * d;
+				}
+			}
+		}
+
+		float error = 0.0f;
+		for(int i = 0; i < 16; ++i)
+		{
+			int best = 0;
+			for (int p = 1; p < TPaletteSize; ++p)
+				if (dist[p][i] < dist[best][i]) best = p;
+			indices[i] = uint8_t(best);
+			error += dist[best][i];
+		}
+		return error;
+	}
+
+	float fitColorIndices(const Block& b, uint16_t c0, uint16_t c1, uint8_t* indices)
+	{
+		float palette[4][4];
+		unpackRgb565(c0, palette[0]);
+		unpackRgb565(c1, palette[1]);
+		for(int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		return fitIndices(b, 3, palette, indices);
+	}
+
+	// rgb part of bc1/bc3 (always four color mode)
+	void encodeColorBlock(const Block& b, BlockCompression::Quality quality, uint8_t* dst)
+	{
+		float e0[4], e1[4];
+		computeEndpoints(b, 3, quality, e0, e1);
+
+		uint16_t c0 = packRgb565(e0);
+		uint16_t c1 = packRgb565(e1);
+		uint8_t indices[16];
+		float error = fitColorIndices(b, std::max(c0, c1), std::min(c0, c1), indices);
+
+		if(quality == BlockCompression::Quality::High)
+		{
+			static constexpr float weights[] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			for(int iteration = 0; iteration < 2; ++iteration)
+			{
+				float t[16];
+				for (int i = 0; i < 16; ++i)
+					t[i] = weights[indices[i]];
+				if (!refineEndpoints(b, 3, t, e0, e1)) break;
+
+				const auto n0 = packRgb565(e0);
+				const auto n1 = packRgb565(e1);
+				uint8_t newIndices[16];
+				const float newError = fitColorIndices(b, std::max(n0, n1), std::min(n0, n1), newIndices);
+				if (newError >= error) break;
+				error = newError;
+				c0 = n0;
+				c1 = n1;
+				std::copy(newIndices, newIndices + 16, indices);
+			}
+		}
+
+		// four color mode requires c0 > c1
+		if (c0 < c1) std::swap(c0, c1);
+
+		uint32_t bits = 0;
+		if(c0 != c1)
+		{
+			for (int i = 0; i < 16; ++i)
+				bits |= uint32_t(indices[i]) << (2 * i);
+		}
+
+		std::memcpy(dst, &c0, 2);
+		std::memcpy(dst + 2, &c1, 2);
+		std::memcpy(dst + 4, &bits, 4);
+	}
+
+	// single channel block (bc3 alpha, bc4, bc5)
+	void encodeChannelBlock(const float* values, uint8_t* dst)
+	{
+		const auto a0 = uint8_t(std::lround(*std::max_element(values, values + 16)));
+		const auto a1 = uint8_t(std::lround(*std::min_element(values, values + 16)));
+		dst[0] = a0;
+		dst[1] = a1;
+
+		uint64_t bits = 0;
+		if(a0 != a1)
+		{
+			// eight value mode (a0 > a1)
+			float palette[8];
+			palette[0] = a0;
+			palette[1] = a1;
+			for (int i = 2; i < 8; ++i)
+				palette[i] = (float(8 - i) * a0 + float(i - 1) * a1) / 7.0f;
+
+			for(int i = 0; i < 16; ++i)
+			{
+				int best = 0;
+				for (int p = 1; p < 8; ++p)
+					if (std::abs(values[i] - palette[p]) < std::abs(values[i] - palette[best])) best = p;
+				bits |= uint64_t(best) << (3 * i);
+			}
+		}
+
+		std::memcpy(dst + 2, &bits, 6);
+	}
+
+	/// \brief quantizes an endpoint to 7 bits + p-bit
+	/// \return p-bit
+	uint32_t quantizeBc7Endpoint(const float* e, uint32_t* q)
+	{
+		float bestError = FLT_MAX;
+		uint32_t bestP = 0;
+		for(uint32_t p = 0; p < 2; ++p)
+		{
+			uint32_t cur[4];
+			float error = 0.0f;
+			for(int c = 0; c < 4; ++c)
+			{
+				cur[c] = uint32_t(std::clamp(std::lround((e[c] - float(p)) / 2.0f), 0l, 127l));
+				const float d = float((cur[c] << 1) | p) - e[c];
+				error += d * d;
+			}
+			if(error < bestError)
+			{
+				bestError = error;
+				bestP = p;
+				std::copy(cur, cur + 4, q);
+			}
+		}
+		return bestP;
+	}
+
+	static constexpr int s_bc7Weights[] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float fitBc7Indices(const Block& b, const uint32_t* q0, uint32_t p0, const uint32_t* q1, uint32_t p1, uint8_t* indices)
+	{
+		float palette[16][4];
+		for(int i = 0; i < 16; ++i)
+		{
+			for(int c = 0; c < 4; ++c)
+			{
+				const int v0 = int((q0[c] << 1) | p0);
+				const int v1 = int((q1[c] << 1) | p1);
+				palette[i][c] = float(((64 - s_bc7Weights[i]) * v0 + s_bc7Weights[i] * v1 + 32) >> 6);
+			}
+		}
+		return fitIndices(b, 4, palette, indices);
+	}
+
+	// bc7 mode 6: single subset, rgba 7.7.7.7 endpoints with unique p-bits, 4 bit indices
+	void encodeBc7Block(const Block& b, BlockCompression::Quality quality, uint8_t* dst)
+	{
+		float e0[4], e1[4];
+		computeEndpoints(b, 4, quality, e0, e1);
+
+		uint32_t q0[4], q1[4];
+		uint32_t p0 = quantizeBc7Endpoint(e0, q0);
+		uint32_t p1 = quantizeBc7Endpoint(e1, q1);
+		uint8_t indices[16];
+		float error = fitBc7Indices(b, q0, p0, q1, p1, indices);
+
+		if(quality == BlockCompression::Quality::High)
+		{
+			for(int iteration = 0; iteration < 2; ++iteration)
+			{
+				float t[16];
+				for (int i = 0; i < 16; ++i)
+					t[i] = float(s_bc7Weights[indices[i]]) / 64.0f;
+				if (!refineEndpoints(b, 4, t, e0, e1)) break;
+
+				uint32_t n0[4], n1[4];
+				const auto np0 = quantizeBc7Endpoint(e0, n0);
+				const auto np1 = quantizeBc7Endpoint(e1, n1);
+				uint8_t newIndices[16];
+				const float newError = fitBc7Indices(b, n0, np0, n1, np1, newIndices);
+				if (newError >= error) break;
+				error = newError;
+				std::copy(n0, n0 + 4, q0);
+				std::copy(n1, n1 + 4, q1);
+				p0 = np0;
+				p1 = np1;
+				std::copy(newIndices, newIndices + 16, indices);
+			}
+		}
+
+		// the most significant bit of the anchor index is implicitly zero
+		if(indices[0] & 8)
+		{
+			std::swap(q0, q1);
+			std::swap(p0, p1);
+			for (auto& i : indices)
+				i = uint8_t(15 - i);
+		}
+
+		std::memset(dst, 0, 16);
+		BitWriter writer(dst);
+		writer.write(1 << 6, 7); // mode 6
+		for(int c = 0; c < 4; ++c)
+		{
+			writer.write(q0[c], 7);
+			writer.write(q1[c], 7);
+		}
+		writer.write(p0, 1);
+		writer.write(p1, 1);
+		writer.write(indices[0], 3);
+		for (int i = 1; i < 16; ++i)
+			writer.write(indices[i], 4);
+	}
+}
+
+size_t BlockCompression::getBlockSize(Format format)
+{
+	switch (format)
+	{
+	case Format::BC1: return 8;
+	case Format::BC3:
+	case Format::BC5:
+	case Format::BC7: return 16;
+	}
+	throw std::runtime_error("unknown block compression format");
+}
+
+size_t BlockCompression::getCompressedSize(Format format, int width, int height)
+{
+	return size_t((width + 3) / 4) * size_t((height + 3) / 4) * getBlockSize(format);
+}
+
+void BlockCompression::compress(const Image& image, Format format, Quality quality, uint8_t* dst)
+{
+	const int blocksX = (image.getWidth() + 3) / 4;
+	const int blocksY = (image.getHeight() + 3) / 4;
+	const size_t blockSize = getBlockSize(format);
+
+	std::vector<int> rows(blocksY);
+	std::iota(rows.begin(), rows.end(), 0);
+	std::for_each(std::execution::par, rows.begin(), rows.end(), [&](int by)
+	{
+		Block block;
+		for(int bx = 0; bx < blocksX; ++bx)
+		{
+			loadBlock(image, bx, by, block);
+			auto out = dst + (size_t(by) * blocksX + bx) * blockSize;
+			switch (format)
+			{
+			case Format::BC1:
+				encodeColorBlock(block, quality, out);
+				break;
+			case Format::BC3:
+				encodeChannelBlock(block.c[3], out);
+				encodeColorBlock(block, quality, out + 8);
+				break;
+			case Format::BC5:
+				encodeChannelBlock(block.c[0], out);
+				encodeChannelBlock(block.c[1], out + 8);
+				break;
+			case Format::BC7:
+				encodeBc7Block(block, quality, out);
+				break;
+			}
+		}
+	});
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "Image.h"
+
+// in-process BCn encoder for the dds export
+class BlockCompression
+{
+public:
+	enum class Format
+	{
+		BC1, // opaque rgb
+		BC3, // rgb + separate alpha block
+		BC5, // two channels (normal maps)
+		BC7 // rgba (mode 6)
+	};
+
+	enum class Quality
+	{
+		Fast, // bounding box endpoints
+		Normal, // principal axis endpoints
+		High // principal axis endpoints + least squares refinement
+	};
+
+	/// bytes per 4x4 block
+	static size_t getBlockSize(Format format);
+	/// size in bytes of a compressed image with the given dimensions
+	static size_t getCompressedSize(Format format, int width, int height);
+
+	/// \brief compresses the image into dst. Rows of blocks are processed in parallel
+	/// \param dst must hold at least getCompressedSize() bytes
+	static void compress(const Image& image, Format format, Quality quality, uint8_t* dst);
+};
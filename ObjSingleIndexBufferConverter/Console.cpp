@@ -1,31 +1,48 @@
 #include "Console.h"
 #include <iostream>
 #include <chrono>
+#include <mutex>
 
 static const char* lastProgressTitle = nullptr;
 std::chrono::high_resolution_clock::time_point lastOutput;
+// console functions may be called from the texture worker threads
+static std::mutex s_mutex;
+static thread_local Console::Sink* s_sink = nullptr;
+
+void Console::setThreadSink(Sink* sink)
+{
+	s_sink = sink;
+}
 
 void Console::info(const std::string& text)
 {
-	if (PrintInfo)
-		write("INF: " + text);
+	if (!PrintInfo) return;
+	if (s_sink) return s_sink->message("info", text);
+	std::lock_guard<std::mutex> lock(s_mutex);
+	write("INF: " + text);
 }
 
 void Console::warning(const std::string& text)
 {
-	if (PrintWarning)
-		write("WAR: " + text);
+	if (!PrintWarning) return;
+	if (s_sink) return s_sink->message("warning", text);
+	std::lock_guard<std::mutex> lock(s_mutex);
+	write("WAR: " + text);
 }
 
 void Console::error(const std::string& text)
 {
-	if (PrintError)
-		write("ERR: " + text);
+	if (!PrintError) return;
+	if (s_sink) return s_sink->message("error", text);
+	std::lock_guard<std::mutex> lock(s_mutex);
+	write("ERR: " + text);
 }
 
 void Console::progress(const char* what, size_t curCount, size_t totalCount)
 {
 	if (!PrintInfo) return;
+	if (s_sink) return s_sink->progress(what, curCount, totalCount);
+	std::lock_guard<std::mutex> lock(s_mutex);
 
 	// print finished message
 	if(curCount == totalCount)
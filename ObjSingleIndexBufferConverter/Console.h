@@ -19,6 +19,21 @@ public:
 	/// \param totalCount maximum value of curCount
 	static void progress(const char* what, size_t curCount, size_t totalCount);
 
+	/// \brief receives the messages of a thread instead of stderr (used by the conversion server)
+	class Sink
+	{
+	public:
+		virtual ~Sink() = default;
+		/// \param type "info", "warning" or "error"
+		virtual void message(const char* type, const std::string& text) = 0;
+		/// \brief called for every progress update (not throttled)
+		virtual void progress(const char* what, size_t curCount, size_t totalCount) = 0;
+	};
+
+	/// \brief redirects the output of the calling thread. nullptr restores stderr output.
+	/// Worker threads that are started by the conversion (parallel algorithms) still write to stderr
+	static void setThreadSink(Sink* sink);
+
 	inline static bool PrintInfo = true;
 	inline static bool PrintWarning = true;
 	inline static bool PrintError = true;
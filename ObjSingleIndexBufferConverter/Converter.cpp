@@ -2,9 +2,28 @@
 #include "FileHelper.h"
 #include <algorithm>
 #include "glm.h"
-#include <iostream>
 #include "Console.h"
 #include "TextureConverter.h"
+#include "TextureAtlas.h"
+#include "XXHash64.h"
+#include "EmitterTable.h"
+#include "Watcher.h"
+#include "ObjCache.h"
+#include "MeshSpill.h"
+#include "ObjLineFilter.h"
+#include "InputFile.h"
+#include "PlyLoader.h"
+#include "SceneList.h"
+#include "Profiler.h"
+#include <set>
+#include "ImageProbe.h"
+#include <execution>
+#include <numeric>
+#include <map>
+#include <fstream>
+#include <cstring>
+#include <sstream>
+#include "../json/single_include/nlohmann/json.hpp"
 
 Converter::Converter()
 	:
@@ -13,32 +32,269 @@ UseSingleFile(false),
 UseTexcoords(true),
 RemoveDuplicates(false),
 GenerateTextures(true),
-RemoveTolerance(0.00001f)
+CompressTextures(false),
+TextureQuality(BlockCompression::Quality::Normal),
+UseKtx2(false),
+SupercompressTextures(true),
+SeparateAlphaTest(true),
+RemoveTolerance(0.00001f),
+AtlasSize(0),
+MaxTextureSize(0),
+TexelDensity(0.0f),
+MergeMaterials(true),
+ExtractEmitters(false),
+PackChannels(true),
+UseObjCache(false),
+StreamShapes(false),
+MemoryBudget(0)
 {
 
 }
 
+Converter::~Converter() = default;
+
 void Converter::convert(std::filesystem::path src, std::filesystem::path dst)
 {
-	m_texConvert = TextureConverter(src.parent_path(), dst.parent_path(), GenerateTextures);
-	load(src);	
+	if(SceneList::isSceneList(src))
+	{
+		const SceneList list(src);
+		m_texConvert = TextureConverter(list.getRoot(), dst.parent_path(), getTextureSettings());
+		load(list);
+	}
+	else
+	{
+		m_texConvert = TextureConverter(src.parent_path(), dst.parent_path(), getTextureSettings());
+		load(src);
+	}
 	save(dst);
 }
 
+void Converter::watch(std::filesystem::path src, std::filesystem::path dst)
+{
+	if (SceneList::isSceneList(src))
+		throw std::runtime_error("watch mode does not support scene lists");
+	m_keepMeshes = true;
+
+	// the first pass is a full conversion
+	bool objChanged = true;
+	bool mtlChanged = false;
+	while(true)
+	{
+		// snapshot before converting => files that are modified during the conversion trigger the next pass
+		const auto start = std::filesystem::file_time_type::clock::now();
+		Watcher watcher(getWatchedFiles(src));
+
+		bool failed = false;
+		try
+		{
+			if (mtlChanged && !objChanged && !reloadMaterials())
+				objChanged = true;
+
+			// a new texture converter forgets the converted textures => the texture cache decides what is exported again
+			m_texConvert = TextureConverter(src.parent_path(), dst.parent_path(), getTextureSettings());
+			if (objChanged)
+			{
+				m_attrib = tinyobj::attrib_t();
+				m_shapes.clear();
+				m_materials.clear();
+				m_meshCache.clear();
+				load(src);
+			}
+			save(dst);
+			Console::info("updated " + dst.string());
+		}
+		catch(const std::exception& e)
+		{
+			// keep watching, the user will probably fix the file
+			Console::error(e.what());
+			failed = true;
+		}
+
+		// files that are referenced for the first time (material libraries and textures)
+		watcher.add(getWatchedFiles(src), start);
+
+		Console::info("watching for changes");
+		const auto changed = watcher.wait();
+
+		objChanged = false;
+		mtlChanged = false;
+		for(const auto& file : changed)
+		{
+			Console::info("changed: " + file.string());
+			if (file == std::filesystem::absolute(src)) objChanged = true;
+			for (const auto& mtl : m_mtlFiles)
+				if (file == std::filesystem::absolute(mtl)) mtlChanged = true;
+		}
+		// a failed pass might have left a partially loaded scene
+		if (failed) objChanged = true;
+	}
+}
+
+TextureConverter::Settings Converter::getTextureSettings() const
+{
+	TextureConverter::Settings texSettings;
+	texSettings.writeFiles = GenerateTextures;
+	texSettings.compress = CompressTextures;
+	texSettings.quality = TextureQuality;
+	texSettings.container = UseKtx2 ? TextureConverter::Container::Ktx2 : TextureConverter::Container::Dds;
+	texSettings.supercompress = SupercompressTextures;
+	return texSettings;
+}
+
+std::vector<std::filesystem::path> Converter::findMtlFiles(const std::filesystem::path& src)
+{
+	if(PlyLoader::isPly(src))
+	{
+		const auto mtl = PlyLoader::getMtlFilename(src);
+		if (std::filesystem::exists(mtl)) return { mtl };
+		return {};
+	}
+
+	InputFile file(src);
+	std::vector<std::filesystem::path> res;
+	std::string line;
+	while(std::getline(file.getStream(), line))
+	{
+		if (line.compare(0, 7, "mtllib ") != 0) continue;
+		// file names are separated by whitespace
+		std::istringstream stream(line.substr(7));
+		std::string name;
+		while (stream >> name)
+			res.push_back(src.parent_path() / name);
+	}
+	return res;
+}
+
+bool Converter::reloadMaterials()
+{
+	Console::info("reloading materials");
+
+	std::vector<tinyobj::material_t> materials;
+	std::map<std::string, int> materialMap;
+	for(const auto& mtl : m_mtlFiles)
+	{
+		std::ifstream file(mtl);
+		if (!file.is_open()) return false;
+		std::string warnings, errors;
+		tinyobj::LoadMtl(&materialMap, &materials, &file, &warnings, &errors);
+		if (!errors.empty()) return false;
+	}
+
+	// shapes reference materials by index => match by name
+	std::vector<int> remap(m_materials.size());
+	for(size_t i = 0; i < m_materials.size(); ++i)
+	{
+		auto it = materialMap.find(m_materials[i].name);
+		if (it == materialMap.end()) return false;
+		remap[i] = it->second;
+	}
+
+	for (auto& ids : m_sourceMaterialIds)
+		for (auto& id : ids)
+			if (id >= 0) id = remap[id];
+
+	m_materials = std::move(materials);
+	for (auto& m : m_materials)
+		fixMaterialPaths(m);
+	return true;
+}
+
+std::vector<std::filesystem::path> Converter::getWatchedFiles(const std::filesystem::path& src) const
+{
+	std::set<std::filesystem::path> files;
+	files.insert(src);
+	files.insert(m_mtlFiles.begin(), m_mtlFiles.end());
+	for(const auto& m : m_materials)
+	{
+		for(const auto* tex : { &m.diffuse_texname, &m.alpha_texname, &m.specular_texname, &m.bump_texname,
+			&m.normal_texname, &m.roughness_texname, &m.metallic_texname, &m.ambient_texname })
+		{
+			if (!tex->empty())
+				files.insert(m_srcDirectory / *tex);
+		}
+	}
+	return std::vector<std::filesystem::path>(files.begin(), files.end());
+}
+
+uint64_t Converter::getMeshSignature(const std::vector<hrsf::Material>& materials) const
+{
+	XXHash64 hash;
+	for (const auto& s : m_shapes)
+		hash.update(s.mesh.material_ids.data(), s.mesh.material_ids.size() * sizeof(int));
+	// mesh buckets
+	for(size_t i = 0; i < materials.size(); ++i)
+	{
+		const uint8_t flags[] = {
+			uint8_t(materials[i].data.flags & hrsf::MaterialData::Transparent ? 1 : 0),
+			uint8_t(m_alphaTestMaterials.count(uint32_t(i)))
+		};
+		hash.update(flags, sizeof(flags));
+	}
+	// atlas texcoords
+	std::map<int, UvTransform> transforms(m_uvTransforms.begin(), m_uvTransforms.end());
+	for(const auto& t : transforms)
+	{
+		hash.update(&t.first, sizeof(t.first));
+		hash.update(&t.second, sizeof(t.second));
+	}
+	return hash.digest();
+}
+
 void Converter::load(std::filesystem::path src)
 {
+	Profiler::Scope profile("load");
 	Console::info("loading " + src.string());
 
 	const auto inputDirectory = src.parent_path();
+	m_srcDirectory = inputDirectory;
 	std::string warnings;
 	std::string errors;
 
-	auto srcString = src.string();
-	auto dirString = inputDirectory.string();
-	bool res = tinyobj::LoadObj(&m_attrib, &m_shapes, &m_materials, &warnings, &errors, srcString.c_str(),
-		dirString.c_str(), true);
-	if (!res || !errors.empty())
-		throw std::runtime_error("obj loader: " + errors);
+	const auto skippedKeywords = getSkippedKeywords();
+	if(PlyLoader::isPly(src))
+	{
+		// binary data => no text parsing and no obj cache
+		if (StreamShapes) Console::info("ply files are converted without streaming");
+		Profiler::Scope profilePly("parse ply");
+		PlyLoader::load(src, m_attrib, m_shapes, m_materials, UseNormals, UseTexcoords);
+		if (m_shapes.empty() && (OutComponents & hrsf::Component::Mesh))
+			throw std::runtime_error("ply file has no faces: " + src.string());
+	}
+	else if(StreamShapes || !skippedKeywords.empty())
+	{
+		if (UseObjCache && !StreamShapes)
+			Console::info("obj cache is not used because attributes are skipped");
+		parseObj(src, StreamShapes);
+	}
+	else if(UseObjCache && ObjCache::load(src, m_attrib, m_shapes, m_materials))
+	{
+		Console::info("loaded " + ObjCache::getFilename(src).string());
+	}
+	else
+	{
+		Profiler::Scope profileParse("parse obj");
+		// gzip compressed files are decompressed while they are parsed
+		InputFile file(src);
+		if (file.isCompressed())
+			Console::info("decompressing " + src.filename().string());
+		tinyobj::MaterialFileReader materialReader(inputDirectory.string() + "/");
+		bool res = tinyobj::LoadObj(&m_attrib, &m_shapes, &m_materials, &warnings, &errors, &file.getStream(),
+			&materialReader, true);
+		if (!res || !errors.empty())
+			throw std::runtime_error("obj loader: " + errors);
+
+		if(UseObjCache)
+		{
+			try
+			{
+				ObjCache::save(src, findMtlFiles(src), m_attrib, m_shapes, m_materials);
+			}
+			catch(const std::exception& e)
+			{
+				Console::warning("could not write obj cache: " + std::string(e.what()));
+			}
+		}
+	}
 
 	Console::info("# of vertices  = " + std::to_string(static_cast<int>(m_attrib.vertices.size()) / 3));
 	Console::info("# of normals   = " + std::to_string(static_cast<int>(m_attrib.normals.size()) / 3));
@@ -47,7 +303,7 @@ void Converter::load(std::filesystem::path src)
 	Console::info("# of shapes    = " + std::to_string(static_cast<int>(m_shapes.size())));
 
 	// count triangles
-	size_t numIndices = 0;
+	size_t numIndices = m_numStreamedIndices;
 	for (const auto& s : m_shapes)
 	{
 		numIndices += s.mesh.indices.size();
@@ -55,218 +311,459 @@ void Converter::load(std::filesystem::path src)
 	Console::info("# of indices   = " + std::to_string(numIndices));
 	Console::info("# of triangles = " + std::to_string(numIndices / 3));
 
-	if (m_attrib.vertices.empty())
+	if (m_attrib.vertices.empty() && OutComponents & hrsf::Component::Mesh)
 		throw std::runtime_error("no vertices found");
 
 	// fix material texture paths
-	for(auto& m : m_materials)
+	for (auto& m : m_materials)
+		fixMaterialPaths(m);
+
+	if(m_keepMeshes)
+	{
+		// required for reloading the materials
+		m_mtlFiles = findMtlFiles(src);
+		m_sourceMaterialIds.clear();
+		for (const auto& shape : m_shapes)
+			m_sourceMaterialIds.push_back(shape.mesh.material_ids);
+	}
+}
+
+void Converter::load(const SceneList& list)
+{
+	Profiler::Scope profile("load scene list");
+	const auto& inputs = list.getInputs();
+	if(StreamShapes)
+		Console::info("scene lists are converted without streaming");
+
+	// every input is parsed by its own converter
+	std::vector<Converter> parts(inputs.size());
+	std::vector<std::string> errors(inputs.size());
+	std::vector<size_t> indices(inputs.size());
+	std::iota(indices.begin(), indices.end(), size_t(0));
+	std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t i)
+	{
+		auto& part = parts[i];
+		part.OutComponents = OutComponents;
+		part.UseNormals = UseNormals;
+		part.UseTexcoords = UseTexcoords;
+		part.ExtractEmitters = ExtractEmitters;
+		part.UseObjCache = UseObjCache;
+		try
+		{
+			part.load(inputs[i].file);
+		}
+		catch(const std::exception& e)
+		{
+			errors[i] = inputs[i].file.string() + ": " + e.what();
+		}
+	});
+	for (const auto& e : errors)
+		if (!e.empty()) throw std::runtime_error(e);
+
+	m_srcDirectory = list.getRoot();
+	for (size_t i = 0; i < parts.size(); ++i)
+		append(std::move(parts[i]), inputs[i].transform, list.getRoot());
+
+	size_t numIndices = 0;
+	for (const auto& s : m_shapes)
+		numIndices += s.mesh.indices.size();
+	Console::info("merged " + std::to_string(inputs.size()) + " inputs: " + std::to_string(m_attrib.vertices.size() / 3) + " vertices, "
+		+ std::to_string(numIndices / 3) + " triangles, " + std::to_string(m_materials.size()) + " materials");
+}
+
+void Converter::append(Converter&& part, const glm::mat4& transform, const std::filesystem::path& root)
+{
+	const auto vertexOffset = int(m_attrib.vertices.size() / 3);
+	const auto normalOffset = int(m_attrib.normals.size() / 3);
+	const auto texcoordOffset = int(m_attrib.texcoords.size() / 2);
+	const auto materialOffset = int(m_materials.size());
+
+	const auto& src = part.m_attrib;
+	const auto normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+	for(size_t i = 0; i + 2 < src.vertices.size(); i += 3)
 	{
-		fixPath(m.diffuse_texname);
-		fixPath(m.alpha_texname);
-		fixPath(m.ambient_texname);
-		fixPath(m.bump_texname);
-		fixPath(m.displacement_texname);
-		fixPath(m.metallic_texname);
-		fixPath(m.normal_texname);
-		fixPath(m.reflection_texname);
-		fixPath(m.roughness_texname);
-		fixPath(m.sheen_texname);
-		fixPath(m.specular_highlight_texname);
-		fixPath(m.specular_texname);
+		const auto p = transform * glm::vec4(src.vertices[i], src.vertices[i + 1], src.vertices[i + 2], 1.0f);
+		m_attrib.vertices.insert(m_attrib.vertices.end(), { p.x, p.y, p.z });
 	}
+	for(size_t i = 0; i + 2 < src.normals.size(); i += 3)
+	{
+		auto n = normalTransform * glm::vec3(src.normals[i], src.normals[i + 1], src.normals[i + 2]);
+		if (glm::dot(n, n) > 0.0f) n = glm::normalize(n);
+		m_attrib.normals.insert(m_attrib.normals.end(), { n.x, n.y, n.z });
+	}
+	m_attrib.texcoords.insert(m_attrib.texcoords.end(), src.texcoords.begin(), src.texcoords.end());
+
+	// mirroring transformations flip the triangle orientation
+	const bool flipWinding = glm::determinant(glm::mat3(transform)) < 0.0f;
+	for(auto& s : part.m_shapes)
+	{
+		for(auto& idx : s.mesh.indices)
+		{
+			if (idx.vertex_index >= 0) idx.vertex_index += vertexOffset;
+			if (idx.normal_index >= 0) idx.normal_index += normalOffset;
+			if (idx.texcoord_index >= 0) idx.texcoord_index += texcoordOffset;
+		}
+		if (flipWinding)
+			for (size_t i = 0; i + 2 < s.mesh.indices.size(); i += 3)
+				std::swap(s.mesh.indices[i + 1], s.mesh.indices[i + 2]);
+		for (auto& id : s.mesh.material_ids)
+			if (id >= 0) id += materialOffset;
+		m_shapes.push_back(std::move(s));
+	}
+
+	// textures of all inputs are converted relative to the common root => shared textures are converted once
+	const auto partDirectory = part.m_srcDirectory;
+	for(auto& m : part.m_materials)
+	{
+		for (auto* tex : getTextureNames(m))
+		{
+			if (tex->empty()) continue;
+			const auto relative = (partDirectory / std::filesystem::u8path(*tex)).lexically_normal().lexically_relative(root);
+			// e.g. absolute texture path on another drive
+			if (relative.empty())
+				throw std::runtime_error("texture " + *tex + " can not be referenced relative to the scene root " + root.string());
+			*tex = relative.generic_u8string();
+		}
+		m_materials.push_back(std::move(m));
+	}
+
+	part.m_attrib = tinyobj::attrib_t();
+	part.m_shapes.clear();
+	part.m_materials.clear();
+}
+
+void Converter::fixMaterialPaths(tinyobj::material_t& m)
+{
+	for (auto* tex : getTextureNames(m))
+		fixPath(*tex);
+}
+
+std::vector<std::string*> Converter::getTextureNames(tinyobj::material_t& m)
+{
+	return {
+		&m.diffuse_texname, &m.alpha_texname, &m.ambient_texname, &m.bump_texname,
+		&m.displacement_texname, &m.metallic_texname, &m.normal_texname, &m.reflection_texname,
+		&m.roughness_texname, &m.sheen_texname, &m.specular_highlight_texname, &m.specular_texname
+	};
 }
 
 void Converter::save(std::filesystem::path dst)
 {
+	Profiler::Scope profile("save");
 	Console::info("converting to hrsf");
 
+	// watch mode: undo the material merging of the last save()
+	for (size_t i = 0; i < m_sourceMaterialIds.size() && i < m_shapes.size(); ++i)
+		m_shapes[i].mesh.material_ids = m_sourceMaterialIds[i];
+
+	// atlases change texcoords => only when meshes and materials are written
+	if (AtlasSize > 0 && GenerateTextures && !m_spill && OutComponents & hrsf::Component::Mesh && OutComponents & hrsf::Component::Material)
+	{
+		Profiler::Scope profileAtlas("texture atlas");
+		buildAtlases();
+	}
+
 	std::vector<hrsf::Material> materials;
 	// materials are also required for mesh splitting
 	if(OutComponents & hrsf::Component::Mesh || OutComponents & hrsf::Component::Material)
 		materials = getMaterials();
 
+	if (MergeMaterials && !m_spill && OutComponents & hrsf::Component::Mesh)
+	{
+		Profiler::Scope profileMerge("merge materials");
+		mergeMaterials(materials);
+	}
+
 	std::vector<hrsf::Mesh> mesh;
-	if(OutComponents & hrsf::Component::Mesh)
+	if(OutComponents & hrsf::Component::Mesh && m_spill)
 	{
-		mesh = convertMesh(materials);
+		mesh = mergeSpilledMeshes(materials);
+	}
+	else if(OutComponents & hrsf::Component::Mesh)
+	{
+		const auto signature = m_keepMeshes ? getMeshSignature(materials) : 0;
+		if(m_keepMeshes && !m_meshCache.empty() && signature == m_meshSignature)
+		{
+			Console::info("meshes did not change");
+			mesh = m_meshCache;
+		}
+		else
+		{
+			mesh = convertMesh(materials);
+			if(m_keepMeshes)
+			{
+				m_meshCache = mesh;
+				m_meshSignature = signature;
+			}
+		}
 	}
 	
-	hrsf::SceneFormat scene(std::move(mesh), getCamera(), getLights(), move(materials), getEnvironment());
-	scene.verify();
+	{
+		Profiler::Scope profileWrite("write scene");
+		hrsf::SceneFormat scene(std::move(mesh), getCamera(), getLights(), move(materials), getEnvironment());
+		scene.verify();
+
+		Console::info("removing unused materials");
+		scene.removeUnusedMaterials();
 
-	Console::info("removing unused materials");
-	scene.removeUnusedMaterials();
+		Console::info("writing to " + dst.string());
+		scene.save(dst, UseSingleFile, OutComponents);
 
-	Console::info("writing to " + dst.string());
-	scene.save(dst, UseSingleFile, OutComponents);
+		if (OutComponents & hrsf::Component::Material)
+			saveMaterialExtensions(dst);
+	}
+
+	if(ExtractEmitters && !m_spill)
+	{
+		Profiler::Scope profileEmitters("emitters");
+		Console::info("extracting emissive triangles");
+		EmitterTable emitters(m_attrib, m_shapes, m_materials, m_flips);
+		m_emittersExtracted = emitters.size();
+		if(!emitters.empty())
+		{
+			auto filename = dst;
+			filename += ".emitters";
+			Console::info("writing " + std::to_string(emitters.size()) + " emitters to " + filename.string());
+			emitters.save(filename);
+		}
+	}
 }
 
 std::vector<hrsf::Mesh> Converter::convertMesh(const std::vector<hrsf::Material>& materials) const
 {
-	uint32_t requestedAttribs = bmf::Position;
-	if(UseNormals)
-		requestedAttribs |= bmf::Normal;
-
-	if(UseTexcoords)
-		requestedAttribs |= bmf::Texcoord0;
-
-
-
 	Console::info("creating meshes");
 	// convert all shapes into seperate binary meshes
 	std::vector<bmf::BinaryMesh16> meshes;
 	size_t curShape = 0;
 	for (const auto& s : m_shapes)
 	{
-		++curShape;
-		std::vector<bmf::BinaryMesh32> bigMeshes;
-		std::vector<bmf::BinaryMesh16> smallMeshes;
+		Profiler::Scope profile("shape conversion");
+		convertShape(s, uint32_t(m_materials.size()), meshes);
+		Console::progress("meshes", ++curShape, m_shapes.size());
+	}
 
-		uint32_t attribs = bmf::Position;
-		if (s.mesh.indices[0].normal_index >= 0 && UseNormals)
-			attribs |= bmf::Normal;
-		if (s.mesh.indices[0].texcoord_index >= 0 && UseTexcoords)
-			attribs |= bmf::Texcoord0;
+	Console::info("removing duplicate vertices and generating missing attributes");
+	const auto generators = createGenerators();
+	size_t curCount = 0;
+	size_t maxVertexCount = 0;
+	for(auto& m : meshes)
+	{
+		processMesh(m, generators);
+		maxVertexCount = std::max(maxVertexCount, size_t(m.getNumVertices()));
+		Console::progress("meshes", ++curCount, meshes.size());
+	}
+	Console::info("Max vertex count per shape: " + std::to_string(maxVertexCount));
 
-		const auto stride = bmf::getAttributeElementStride(attribs);
+	//Console::info("deinstancing shapes");
+	//auto sizeBefore = meshes.size();
+	//bmf::BinaryMesh::deinstanceShapes(meshes, 0.1f);
+	//if(sizeBefore != meshes.size())
+	//	Console::info("reduced shapes from " + std::to_string(sizeBefore) + " to " + std::to_string(meshes.size()));
 
-		// for now brute force create mesh
-		std::vector<float> vertices;
-		std::vector<uint32_t> indices;
+	Console::info("merging meshes");
+	// all opaque, all alpha tested and all transparent meshes belong together
+	std::vector<bmf::BinaryMesh16> buckets[3];
+	buckets[0].reserve(meshes.size());
+	for (auto& m : meshes)
+		buckets[getMeshBucket(m.getShapes()[0].materialId, materials)].emplace_back(std::move(m));
 
-		indices.reserve(s.mesh.indices.size());
-		vertices.reserve(s.mesh.indices.size() * bmf::getAttributeElementStride(attribs));
-		for(const auto & i : s.mesh.indices)
-		{
-			indices.push_back(uint32_t(indices.size()));
+	// put into final vector
+	std::vector<hrsf::Mesh> result;
+	result.reserve(3);
+	for(const auto& bucket : buckets)
+	{
+		if (bucket.empty()) continue;
+		Profiler::Scope profile("merge meshes");
+		result.emplace_back(bmf::BinaryMesh16::mergeShapes(bucket));
+	}
 
-			vertices.push_back(m_attrib.vertices[3 * i.vertex_index]);
-			vertices.push_back(m_attrib.vertices[3 * i.vertex_index + 1]);
-			vertices.push_back(m_attrib.vertices[3 * i.vertex_index + 2]);
-			if(attribs & bmf::Normal)
-			{
-				vertices.push_back(m_attrib.normals[3 * i.normal_index]);
-				vertices.push_back(m_attrib.normals[3 * i.normal_index + 1]);
-				vertices.push_back(m_attrib.normals[3 * i.normal_index + 2]);
-			}
-			if(attribs & bmf::Texcoord0)
+	if (result.empty())
+		throw std::runtime_error("no mesh available");
+
+	Console::info("generating bounding volumes");
+	for(auto& m : result)
+	{
+		Profiler::Scope profile("bounding volumes");
+		m.triangle.generateBoundingVolumes();
+	}
+
+	return result;
+}
+
+void Converter::convertShape(const tinyobj::shape_t& s, uint32_t defaultMaterial, std::vector<bmf::BinaryMesh16>& out) const
+{
+	std::vector<bmf::BinaryMesh32> bigMeshes;
+	std::vector<bmf::BinaryMesh16> smallMeshes;
+
+	uint32_t attribs = bmf::Position;
+	if (s.mesh.indices[0].normal_index >= 0 && UseNormals)
+		attribs |= bmf::Normal;
+	if (s.mesh.indices[0].texcoord_index >= 0 && UseTexcoords)
+		attribs |= bmf::Texcoord0;
+
+	const auto stride = bmf::getAttributeElementStride(attribs);
+
+	// for now brute force create mesh
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+
+	indices.reserve(s.mesh.indices.size());
+	vertices.reserve(s.mesh.indices.size() * bmf::getAttributeElementStride(attribs));
+	for(const auto & i : s.mesh.indices)
+	{
+		const auto face = indices.size() / 3;
+		indices.push_back(uint32_t(indices.size()));
+
+		vertices.push_back(m_attrib.vertices[3 * i.vertex_index]);
+		vertices.push_back(m_attrib.vertices[3 * i.vertex_index + 1]);
+		vertices.push_back(m_attrib.vertices[3 * i.vertex_index + 2]);
+		if(attribs & bmf::Normal)
+		{
+			vertices.push_back(m_attrib.normals[3 * i.normal_index]);
+			vertices.push_back(m_attrib.normals[3 * i.normal_index + 1]);
+			vertices.push_back(m_attrib.normals[3 * i.normal_index + 2]);
+		}
+		if(attribs & bmf::Texcoord0)
+		{
+			float u = m_attrib.texcoords[2 * i.texcoord_index];
+			// directX reverses y coordinate
+			float v = 1.0f - m_attrib.texcoords[2 * i.texcoord_index + 1];
+			if(!m_uvTransforms.empty() && face < s.mesh.material_ids.size())
 			{
-				vertices.push_back(m_attrib.texcoords[2 * i.texcoord_index]);
-				// directX reverses y coordinate
-				vertices.push_back(1.0f - m_attrib.texcoords[2 * i.texcoord_index + 1]);
+				// material texture was packed into an atlas
+				auto it = m_uvTransforms.find(s.mesh.material_ids[face]);
+				if(it != m_uvTransforms.end())
+				{
+					u = u * it->second.scale[0] + it->second.offset[0];
+					v = v * it->second.scale[1] + it->second.offset[1];
+				}
 			}
+			vertices.push_back(u);
+			vertices.push_back(v);
 		}
+	}
 
-		uint32_t materialId;
-		if (s.mesh.material_ids.empty()) // choose default material (will be added by getMaterials() later)
-			materialId = uint32_t(m_materials.size());
-		else
-			materialId = uint32_t(s.mesh.material_ids[0]);
+	uint32_t materialId;
+	if (s.mesh.material_ids.empty()) // choose default material (will be added by getMaterials() later)
+		materialId = defaultMaterial;
+	else
+		materialId = uint32_t(s.mesh.material_ids[0]);
 
-		if (s.mesh.material_ids.size() > 1 && !std::all_of(s.mesh.material_ids.begin(), s.mesh.material_ids.end(), [materialId](auto id)
-			{
-				return id == int(materialId);
-			}))
+	if (s.mesh.material_ids.size() > 1 && !std::all_of(s.mesh.material_ids.begin(), s.mesh.material_ids.end(), [materialId](auto id)
 		{
-			Console::info("found multiple materials for one mesh");
+			return id == int(materialId);
+		}))
+	{
+		Console::info("found multiple materials for one mesh");
 
-			decltype(vertices) newVertices;
-			decltype(indices) newIndices;
-			std::vector<bmf::Shape> shapes;
+		decltype(vertices) newVertices;
+		decltype(indices) newIndices;
+		std::vector<bmf::Shape> shapes;
 
-			shapes.emplace_back(bmf::Shape{
-				0, 0,
-				0, 0,
-				0
-				});
+		shapes.emplace_back(bmf::Shape{
+			0, 0,
+			0, 0,
+			0
+			});
 
-			// split mesh based on materials
-			auto lastMaterial = s.mesh.material_ids[0];
-			uint32_t curIndex = 0;
+		// split mesh based on materials
+		auto lastMaterial = s.mesh.material_ids[0];
+		uint32_t curIndex = 0;
 
-			auto addShape = [&]()
-			{
-				shapes[0].indexCount = curIndex;
-				shapes[0].vertexCount = curIndex;
-				shapes[0].materialId = lastMaterial;
-				curIndex = 0;
-				bigMeshes.emplace_back(attribs, std::move(newVertices), std::move(newIndices), shapes);
-				newVertices.clear();
-				newIndices.clear();
-			};
-
-			for(size_t curFace = 0; curFace < indices.size() / 3; ++curFace)
+		auto addShape = [&]()
+		{
+			shapes[0].indexCount = curIndex;
+			shapes[0].vertexCount = curIndex;
+			shapes[0].materialId = lastMaterial;
+			curIndex = 0;
+			bigMeshes.emplace_back(attribs, std::move(newVertices), std::move(newIndices), shapes);
+			newVertices.clear();
+			newIndices.clear();
+		};
+
+		for(size_t curFace = 0; curFace < indices.size() / 3; ++curFace)
+		{
+			if(s.mesh.material_ids[curFace] != lastMaterial)
 			{
-				if(s.mesh.material_ids[curFace] != lastMaterial)
-				{
-					// add this shape
-					addShape();
-					lastMaterial = s.mesh.material_ids[curFace];
-				}
+				// add this shape
+				addShape();
+				lastMaterial = s.mesh.material_ids[curFace];
+			}
 
-				// push back vertices
-				for(size_t curVertex = 0; curVertex < 3; ++curVertex)
+			// push back vertices
+			for(size_t curVertex = 0; curVertex < 3; ++curVertex)
+			{
+				auto idx = indices[curFace * 3 + curVertex];
+				for(size_t curStride = 0; curStride < stride; ++curStride)
 				{
-					auto idx = indices[curFace * 3 + curVertex];
-					for(size_t curStride = 0; curStride < stride; ++curStride)
-					{
-						newVertices.push_back(vertices[idx * stride + curStride]);
-					}
-
+					newVertices.push_back(vertices[idx * stride + curStride]);
 				}
-				newIndices.push_back(curIndex++);
-				newIndices.push_back(curIndex++);
-				newIndices.push_back(curIndex++);
-			}
-
-			if (newVertices.size()) addShape();
 
-			for(auto& m : bigMeshes)
-			{
-				//m.verify();
-				m.removeDuplicateVertices(); // a lot of duplicate vertices
-				//m.verify();
 			}
+			newIndices.push_back(curIndex++);
+			newIndices.push_back(curIndex++);
+			newIndices.push_back(curIndex++);
 		}
-		else
-		{
-			if (materialId == uint32_t(-1)) // not material => choose default material
-				materialId = uint32_t(m_materials.size());
-
-			std::vector<bmf::Shape> shapes;
 
-			shapes.emplace_back(bmf::Shape{
-			0,
-			uint32_t(indices.size()),
-			0,
-			uint32_t(vertices.size() / stride),
-			materialId
-				});
+		if (newVertices.size()) addShape();
 
-			bigMeshes.emplace_back(attribs, std::move(vertices), std::move(indices), std::move(shapes));
-		}
-		
-		// convert to 16 bit mesh
 		for(auto& m : bigMeshes)
 		{
-			auto res = m.force16BitIndices();
-			for(auto& sm : res)
-			{
-				smallMeshes.emplace_back(std::move(sm));
-			}
+			//m.verify();
+			m.removeDuplicateVertices(); // a lot of duplicate vertices
+			//m.verify();
 		}
+	}
+	else
+	{
+		if (materialId == uint32_t(-1)) // not material => choose default material
+			materialId = defaultMaterial;
 
-		if (smallMeshes.size() > bigMeshes.size())
-			Console::info("forced 16 bit indices");
+		std::vector<bmf::Shape> shapes;
 
-		for(auto& m : smallMeshes)
+		shapes.emplace_back(bmf::Shape{
+		0,
+		uint32_t(indices.size()),
+		0,
+		uint32_t(vertices.size() / stride),
+		materialId
+			});
+
+		bigMeshes.emplace_back(attribs, std::move(vertices), std::move(indices), std::move(shapes));
+	}
+	
+	// convert to 16 bit mesh
+	for(auto& m : bigMeshes)
+	{
+		auto res = m.force16BitIndices();
+		for(auto& sm : res)
 		{
-			meshes.emplace_back(std::move(m));
+			smallMeshes.emplace_back(std::move(sm));
 		}
-		
-		Console::progress("meshes", curShape, m_shapes.size());
 	}
 
+	if (smallMeshes.size() > bigMeshes.size())
+		Console::info("forced 16 bit indices");
+
+	for(auto& m : smallMeshes)
+	{
+		out.emplace_back(std::move(m));
+	}
+}
+
+uint32_t Converter::getRequestedAttributes() const
+{
+	uint32_t requestedAttribs = bmf::Position;
+	if(UseNormals)
+		requestedAttribs |= bmf::Normal;
+
+	if(UseTexcoords)
+		requestedAttribs |= bmf::Texcoord0;
+	return requestedAttribs;
+}
+
+std::vector<std::unique_ptr<bmf::VertexGenerator>> Converter::createGenerators()
+{
 	// missing attributes generators
 	std::vector<std::unique_ptr<bmf::VertexGenerator>> generators;
 	// normal generator
@@ -274,82 +771,290 @@ std::vector<hrsf::Mesh> Converter::convertMesh(const std::vector<hrsf::Material>
 	// texcoord generator
 	float defTexCoord[] = { 0.0f, 0.0f };
 	generators.emplace_back(new bmf::ConstantValueGenerator(bmf::ValueVertex(bmf::Attributes::Texcoord0, defTexCoord)));
+	return generators;
+}
+
+void Converter::processMesh(bmf::BinaryMesh16& m, const std::vector<std::unique_ptr<bmf::VertexGenerator>>& generators) const
+{
+	const auto requestedAttribs = getRequestedAttributes();
 
-	Console::info("removing duplicate vertices");
-	size_t curCount = 0;
-	size_t maxVertexCount = 0;
-	for(auto& m : meshes)
 	{
+		Profiler::Scope profile("dedup");
 		m.removeDuplicateVertices();
-		maxVertexCount = std::max(maxVertexCount, size_t(m.getNumVertices()));
-		//m.centerShapes(); // center shapes to improve numerical stability for instances
-		Console::progress("meshes", ++curCount, meshes.size());
 	}
-	Console::info("Max vertex count per shape: " + std::to_string(maxVertexCount));
-
-	//Console::info("deinstancing shapes");
-	//auto sizeBefore = meshes.size();
-	//bmf::BinaryMesh::deinstanceShapes(meshes, 0.1f);
-	//if(sizeBefore != meshes.size())
-	//	Console::info("reduced shapes from " + std::to_string(sizeBefore) + " to " + std::to_string(meshes.size()));
-
-	Console::info("generating missing attributes");
-	curCount = 0;
-	for (auto& m : meshes)
+	//m.centerShapes(); // center shapes to improve numerical stability for instances
 	{
+		Profiler::Scope profile("attribute generation");
 		m.changeAttributes(requestedAttribs, generators);
-		Console::progress("meshes", ++curCount, meshes.size());
 	}
 
-	if(!m_flips.empty())
+	if (m_flips.empty()) return;
+	Profiler::Scope profile("flip");
+
+	const auto stride = bmf::getAttributeElementStride(requestedAttribs);
+	const auto normalOffset = bmf::getAttributeElementOffset(requestedAttribs, bmf::Attributes::Normal);
+
+	for(size_t i = 0; i < m_flips.size(); i += 2)
 	{
-		Console::info("flipping geometry");
+		const auto axis1 = m_flips[i];
+		const auto axis2 = m_flips[i + 1];
+
+		auto& verts = m.getVertices();
+		for(float* v = verts.data(), *end = verts.data() + verts.size(); v < end; v += stride)
+		{
+			std::swap(v[axis1], v[axis2]);
+			std::swap(v[normalOffset + axis1], v[normalOffset + axis2]);
+		}
+	}
+}
+
+int Converter::getMeshBucket(uint32_t materialId, const std::vector<hrsf::Material>& materials) const
+{
+	if (materials.at(materialId).data.flags & hrsf::MaterialData::Transparent)
+		return 2;
+	if (m_alphaTestMaterials.count(materialId))
+		return 1;
+	return 0;
+}
 
-		const auto stride = bmf::getAttributeElementStride(requestedAttribs);
-		const auto normalOffset = bmf::getAttributeElementOffset(requestedAttribs, bmf::Attributes::Normal);
+// converts a raw obj index (1 based, negative = relative, 0 = missing) like tinyobj.
+// indices of skipped attributes are out of range and become -1
+static int fixIndex(int idx, size_t count)
+{
+	if (idx > 0) idx = idx - 1;
+	else if (idx < 0) idx = int(count) + idx;
+	else return -1;
+	return size_t(idx) < count ? idx : -1;
+}
+
+std::vector<std::string> Converter::getSkippedKeywords() const
+{
+	// geometry is only required for meshes and emitters
+	if (!(OutComponents & hrsf::Component::Mesh) && !ExtractEmitters)
+		return { "v", "vn", "vt", "f", "l", "p" };
+
+	std::vector<std::string> res;
+	if (!UseNormals) res.emplace_back("vn");
+	if (!UseTexcoords) res.emplace_back("vt");
+	return res;
+}
+
+void Converter::parseObj(const std::filesystem::path& src, bool stream)
+{
+	Profiler::Scope profile("parse obj");
+	InputFile file(src);
 
-		for(size_t i = 0; i < m_flips.size(); i += 2)
+	m_spill.reset();
+	m_numStreamedIndices = 0;
+	m_peakMemory = 0;
+	if(stream)
+	{
+		if (AtlasSize > 0) Console::warning("texture atlases are not supported by the streaming conversion");
+		if (MergeMaterials) Console::info("materials are not merged by the streaming conversion");
+		if (ExtractEmitters) Console::warning("emitters are not extracted by the streaming conversion");
+		if (TexelDensity > 0.0f) Console::warning("texel density is ignored by the streaming conversion");
+
+		// unique name for concurrent batch jobs
+		const auto spillName = src.stem().string() + "." + std::to_string(reinterpret_cast<uintptr_t>(this)) + ".meshes.tmp";
+		m_spill = std::make_unique<MeshSpill>(std::filesystem::temp_directory_path() / spillName);
+	}
+
+	// unused lines are removed before they are parsed
+	const auto skippedKeywords = getSkippedKeywords();
+	const bool skipGeometry = std::find(skippedKeywords.begin(), skippedKeywords.end(), "f") != skippedKeywords.end();
+	if (skipGeometry && TexelDensity > 0.0f)
+		Console::warning("texel density is ignored because no geometry is converted");
+	ObjLineFilter filter(file.getStream(), skippedKeywords);
+	std::istream filteredFile(&filter);
+	// decompression errors must not end the file silently
+	filteredFile.exceptions(std::ios::badbit);
+
+	struct State
+	{
+		Converter& converter;
+		std::vector<std::unique_ptr<bmf::VertexGenerator>> generators;
+		tinyobj::shape_t shape;
+		int material = -1;
+		// there are no faces => material ids are recorded for each usemtl
+		bool recordMaterials;
+		// position in the compressed file for compressed inputs
+		InputFile& file;
+
+		void progress()
 		{
-			const auto axis1 = m_flips[i];
-			const auto axis2 = m_flips[i + 1];
+			const auto pos = file.getPosition();
+			if (pos > 0) Console::progress("parsing obj (MB)", size_t(pos >> 20), size_t(file.getSize() >> 20) + 1);
+		}
+	} state{ *this, createGenerators(), {}, -1, skipGeometry, file };
 
-			for(auto& m : meshes)
-			{
-				auto& verts = m.getVertices();
-				for(float* v = verts.data(), *end = verts.data() + verts.size(); v < end; v += stride)
-				{
-					std::swap(v[axis1], v[axis2]);
-					std::swap(v[normalOffset + axis1], v[normalOffset + axis2]);
-				}
+	// the callbacks are defined inside a member function => access to the converter members
+	tinyobj::callback_t callback;
+	callback.vertex_cb = [](void* user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t)
+	{
+		auto& v = static_cast<State*>(user)->converter.m_attrib.vertices;
+		v.push_back(x);
+		v.push_back(y);
+		v.push_back(z);
+	};
+	callback.normal_cb = [](void* user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z)
+	{
+		auto& n = static_cast<State*>(user)->converter.m_attrib.normals;
+		n.push_back(x);
+		n.push_back(y);
+		n.push_back(z);
+	};
+	callback.texcoord_cb = [](void* user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t)
+	{
+		auto& t = static_cast<State*>(user)->converter.m_attrib.texcoords;
+		t.push_back(x);
+		t.push_back(y);
+	};
+	callback.index_cb = [](void* user, tinyobj::index_t* indices, int numIndices)
+	{
+		auto& state = *static_cast<State*>(user);
+		const auto& attrib = state.converter.m_attrib;
+		auto& mesh = state.shape.mesh;
 
-				Console::progress("meshes (flip)", ++curCount, meshes.size());
-			}
+		auto fix = [&](tinyobj::index_t i)
+		{
+			i.vertex_index = fixIndex(i.vertex_index, attrib.vertices.size() / 3);
+			i.normal_index = fixIndex(i.normal_index, attrib.normals.size() / 3);
+			i.texcoord_index = fixIndex(i.texcoord_index, attrib.texcoords.size() / 2);
+			return i;
+		};
+
+		// triangle fan
+		for(int i = 1; i + 1 < numIndices; ++i)
+		{
+			mesh.indices.push_back(fix(indices[0]));
+			mesh.indices.push_back(fix(indices[i]));
+			mesh.indices.push_back(fix(indices[i + 1]));
+			mesh.num_face_vertices.push_back(3);
+			mesh.material_ids.push_back(state.material);
 		}
+	};
+	callback.usemtl_cb = [](void* user, const char*, int materialId)
+	{
+		auto& state = *static_cast<State*>(user);
+		state.material = materialId;
+		if (state.recordMaterials)
+			state.shape.mesh.material_ids.push_back(materialId);
+	};
+	callback.mtllib_cb = [](void* user, const tinyobj::material_t* materials, int numMaterials)
+	{
+		// called with all materials that were loaded so far
+		static_cast<State*>(user)->converter.m_materials.assign(materials, materials + numMaterials);
+	};
+	callback.group_cb = [](void* user, const char** names, int numNames)
+	{
+		auto& state = *static_cast<State*>(user);
+		state.converter.flushShape(state.shape, state.generators);
+		state.shape.name = numNames > 0 ? names[0] : "";
+		state.progress();
+	};
+	callback.object_cb = [](void* user, const char* name)
+	{
+		auto& state = *static_cast<State*>(user);
+		state.converter.flushShape(state.shape, state.generators);
+		state.shape.name = name;
+		state.progress();
+	};
+
+	if (m_spill)
+		Console::info("streaming shapes to " + std::filesystem::temp_directory_path().string());
+	std::string warnings, errors;
+	tinyobj::MaterialFileReader materialReader(src.parent_path().string() + "/");
+	const bool res = tinyobj::LoadObjWithCallback(filteredFile, callback, &state, &materialReader, &warnings, &errors);
+	if (!res || !errors.empty())
+		throw std::runtime_error("obj loader: " + errors);
+	flushShape(state.shape, state.generators);
+
+	if (filter.getNumSkipped())
+		Console::info("skipped " + std::to_string(filter.getNumSkipped()) + " unused obj lines");
+	if (m_spill)
+		Console::info("streamed " + std::to_string(m_spill->size()) + " meshes (" + std::to_string(m_spill->getTotalBytes() / (1024 * 1024)) + " MB)");
+}
+
+void Converter::flushShape(tinyobj::shape_t& shape, const std::vector<std::unique_ptr<bmf::VertexGenerator>>& generators)
+{
+	if (shape.mesh.indices.empty() && shape.mesh.material_ids.empty()) return;
+
+	if(!m_spill || shape.mesh.indices.empty())
+	{
+		// converted later by convertMesh() (or only material references)
+		m_shapes.push_back(std::move(shape));
+		shape = tinyobj::shape_t();
+		return;
 	}
 
-	Console::info("merging meshes");
-	// all transparent meshes and all non transparent meshes belong together
-	std::vector<bmf::BinaryMesh16> opaqueMeshes;
-	opaqueMeshes.reserve(meshes.size());
-	std::vector<bmf::BinaryMesh16> transMeshes;
-	transMeshes.reserve(transMeshes.size());
+	std::vector<bmf::BinaryMesh16> meshes;
+	{
+		Profiler::Scope profile("shape conversion");
+		convertShape(shape, uint32_t(-1), meshes);
+	}
 
+	const uint64_t attribBytes = (m_attrib.vertices.size() + m_attrib.normals.size() + m_attrib.texcoords.size()) * sizeof(tinyobj::real_t);
+	const uint64_t shapeBytes = shape.mesh.indices.size() * (sizeof(tinyobj::index_t) + sizeof(int));
+	uint64_t meshBytes = 0;
 	for(auto& m : meshes)
 	{
-		auto matId = m.getShapes()[0].materialId;
-		if (materials.at(matId).data.flags & hrsf::MaterialData::Transparent)
-			transMeshes.emplace_back(std::move(m));
-		else
-			opaqueMeshes.emplace_back(std::move(m));
+		processMesh(m, generators);
+		meshBytes += m.getVertices().size() * sizeof(float) + m.getIndices().size() * sizeof(uint16_t);
+		m_spill->add(m);
 	}
+	trackMemory(attribBytes + shapeBytes + meshBytes, "converting shapes");
+
+	// keep the used material ids for getMaterials()
+	m_numStreamedIndices += shape.mesh.indices.size();
+	std::vector<int> ids = shape.mesh.material_ids;
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+	tinyobj::shape_t meta;
+	meta.name = std::move(shape.name);
+	meta.mesh.material_ids = std::move(ids);
+	m_shapes.push_back(std::move(meta));
+	shape = tinyobj::shape_t();
+}
 
-	// put into final vector
+std::vector<hrsf::Mesh> Converter::mergeSpilledMeshes(const std::vector<hrsf::Material>& materials)
+{
+	// the obj attributes are not required anymore
+	m_attrib = tinyobj::attrib_t();
+
+	const auto defaultMaterial = uint32_t(m_materials.size());
+	auto getMaterial = [&](size_t i)
+	{
+		const auto id = m_spill->getMaterialId(i);
+		return id == uint32_t(-1) ? defaultMaterial : id;
+	};
+
+	Console::info("merging meshes");
 	std::vector<hrsf::Mesh> result;
-	result.reserve(2);
-	if(!opaqueMeshes.empty())
-		result.emplace_back(bmf::BinaryMesh16::mergeShapes(opaqueMeshes));
-	if(!transMeshes.empty())
-		result.emplace_back(bmf::BinaryMesh16::mergeShapes(transMeshes));
+	uint64_t resultBytes = 0;
+	for(int bucket = 0; bucket < 3; ++bucket)
+	{
+		std::vector<size_t> ids;
+		uint64_t bytes = 0;
+		for(size_t i = 0; i < m_spill->size(); ++i)
+		{
+			if (getMeshBucket(getMaterial(i), materials) != bucket) continue;
+			ids.push_back(i);
+			bytes += m_spill->getBytes(i);
+		}
+		if (ids.empty()) continue;
+
+		// source meshes + merged mesh
+		trackMemory(resultBytes + 2 * bytes, "merging meshes");
+
+		Profiler::Scope profile("merge meshes");
+		std::vector<bmf::BinaryMesh16> meshes;
+		meshes.reserve(ids.size());
+		for (auto i : ids)
+			meshes.emplace_back(m_spill->get(i, defaultMaterial));
+		result.emplace_back(bmf::BinaryMesh16::mergeShapes(meshes));
+		resultBytes += bytes;
+	}
 
 	if (result.empty())
 		throw std::runtime_error("no mesh available");
@@ -357,12 +1062,22 @@ std::vector<hrsf::Mesh> Converter::convertMesh(const std::vector<hrsf::Material>
 	Console::info("generating bounding volumes");
 	for(auto& m : result)
 	{
+		Profiler::Scope profile("bounding volumes");
 		m.triangle.generateBoundingVolumes();
 	}
 
 	return result;
 }
 
+void Converter::trackMemory(uint64_t bytes, const char* stage)
+{
+	m_peakMemory = std::max(m_peakMemory, bytes);
+	const auto budget = uint64_t(std::max(int(MemoryBudget), 0)) * 1024 * 1024;
+	if (budget && bytes > budget)
+		throw std::runtime_error("memory budget of " + std::to_string(MemoryBudget) + " MB exceeded while " + stage +
+			" (" + std::to_string(bytes / (1024 * 1024)) + " MB required)");
+}
+
 hrsf::Camera Converter::getCamera() const
 {
 	hrsf::Camera cam; // use default camera for now
@@ -382,53 +1097,121 @@ std::vector<hrsf::Light> Converter::getLights() const
 	return res;
 }
 
-std::vector<hrsf::Material> Converter::getMaterials() const
+std::vector<hrsf::Material> Converter::getMaterials()
 {
+	Profiler::Scope profile("materials");
 	Console::info("converting materials");
 
 	std::vector<hrsf::Material> res;
 	res.reserve(m_materials.size() + 1);
 
+	m_materialExtensions.clear();
+	m_bumpMapsConverted = 0;
+	m_texturesPacked = 0;
+	std::vector<float> uvDensity(m_materials.size(), 0.0f);
+	// the streamed shapes only keep their material ids (see parseObj) and without meshes no faces are parsed
+	const auto skipped = getSkippedKeywords();
+	const bool hasFaces = !m_spill && std::find(skipped.begin(), skipped.end(), "f") == skipped.end();
+	if (TexelDensity > 0.0f && hasFaces)
+		uvDensity = getMaterialUvDensity();
+
+	// textures of unused materials are not converted (the materials will be removed by removeUnusedMaterials())
+	const auto used = getUsedMaterials();
+	const auto numUnused = std::count(used.begin(), used.end(), false);
+	if (numUnused)
+		Console::info("skipping textures of " + std::to_string(numUnused) + " unused materials");
+
 	for(const auto& m : m_materials)
 	{
+		const bool isUsed = used[res.size()];
+		const float density = uvDensity[res.size()];
+		const auto atlas = m_atlasTextures.find(int(res.size()));
 		res.emplace_back();
 		auto& mat = res.back();
 		mat.name = m.name;
-		// textures
-		mat.textures.albedo = m_texConvert.convertTexture(m.diffuse_texname);
-		mat.textures.coverage = m_texConvert.convertTexture(m.alpha_texname);
-		mat.textures.specular = m_texConvert.convertTexture(m.specular_texname);
-		// remaining stuff
-		mat.data = hrsf::MaterialData::Default();
-		std::copy(m.diffuse, m.diffuse + 3, glm::value_ptr(mat.data.albedo));
-		mat.data.specular = (m.specular[0] + m.specular[1] + m.specular[2]) / 3.0f;
-		mat.data.coverage = m.dissolve;
-		std::copy(m.emission, m.emission + 3, glm::value_ptr(mat.data.emission));
-		mat.data.translucency = (m.transmittance[0] + m.transmittance[1] + m.transmittance[2]) / 3.0f;
-		mat.data.metalness = m.metallic;
-		mat.data.ior = m.ior;
-		if(m.roughness != 0.0f)
-		{
-			mat.data.roughness = m.roughness;
-		}
-		else
+		mat.data = getMaterialData(m);
+		m_materialExtensions.emplace_back();
+		auto& ext = m_materialExtensions.back();
+		ext.name = m.name;
+
+		if(isUsed)
 		{
-			// map shininess to roughness
-			mat.data.roughness = sqrt(2.0f / (m.shininess + 2.0f));
+			// textures
+			if (atlas != m_atlasTextures.end())
+				mat.textures.albedo = atlas->second;
+			else
+				mat.textures.albedo = m_texConvert.convertTexture(m.diffuse_texname, TextureConverter::Type::Color, getTextureLimits("albedo", density));
+			mat.textures.coverage = m_texConvert.convertTexture(m.alpha_texname, TextureConverter::Type::Color, getTextureLimits("coverage", density));
+			mat.textures.specular = m_texConvert.convertTexture(m.specular_texname, TextureConverter::Type::Color, getTextureLimits("specular", density));
+			// normal maps are preferred over bump maps
+			if (!m.normal_texname.empty())
+				ext.normal = m_texConvert.convertTexture(m.normal_texname, TextureConverter::Type::Normal, getTextureLimits("normal", density));
+			else if(!m.bump_texname.empty())
+			{
+				const float strength = m.bump_texopt.bump_multiplier != 0.0f ? m.bump_texopt.bump_multiplier : 1.0f;
+				ext.normal = m_texConvert.convertBumpMap(m.bump_texname, strength, getTextureLimits("normal", density));
+				++m_bumpMapsConverted;
+			}
+			// scalar maps are only packed if there is something besides the specular map
+			if(PackChannels && (!m.roughness_texname.empty() || !m.metallic_texname.empty()))
+			{
+				static const char* channelNames[] = { "occlusion", "roughness", "metalness", "specular" };
+				static const char channelLetters[] = { 'r', 'g', 'b', 'a' };
+				std::array<std::filesystem::path, 4> channels = {
+					// the ambient map is often a copy of the diffuse map
+					m.ambient_texname != m.diffuse_texname ? m.ambient_texname : "",
+					m.roughness_texname,
+					m.metallic_texname,
+					m.specular_texname
+				};
+				ext.packed = m_texConvert.convertPacked(channels, getTextureLimits("packed", density));
+				for(size_t c = 0; c < channels.size(); ++c)
+					if (!channels[c].empty()) ext.packedChannels.emplace_back(channelNames[c], channelLetters[c]);
+				++m_texturesPacked;
+			}
 		}
-		mat.data.flags = 0;
 
+		Console::progress("materials", res.size(), m_materials.size());
+	}
 
-		//if (m.illum >= 3) // raytrace on flag
-			//mat.data.flags |= hrsf::MaterialData::Flags::Reflection;
+	Console::info("converting textures");
+	{
+		Profiler::Scope profileTextures("texture export");
+		m_texConvert.convertPending();
+	}
 
+	// identical textures were merged
+	for(auto& mat : res)
+	{
+		mat.textures.albedo = m_texConvert.resolveDuplicate(mat.textures.albedo);
+		mat.textures.coverage = m_texConvert.resolveDuplicate(mat.textures.coverage);
+		mat.textures.specular = m_texConvert.resolveDuplicate(mat.textures.specular);
+	}
+	for (auto& ext : m_materialExtensions)
+	{
+		ext.normal = m_texConvert.resolveDuplicate(ext.normal);
+		ext.packed = m_texConvert.resolveDuplicate(ext.packed);
+	}
+
+	m_alphaTestMaterials.clear();
+	for(size_t i = 0; i < res.size(); ++i)
+	{
+		auto& mat = res[i];
 		// is transparent?
 		bool isTransparent = false;
 		if (mat.data.coverage < 1.0f) isTransparent = true;
 		if (mat.data.translucency > 0.0f) isTransparent = 0.0f;
 		if (!mat.textures.coverage.empty()) isTransparent |= true;
-		if (!mat.textures.albedo.empty() && m_texConvert.hasAlpha(mat.textures.albedo))
-			isTransparent |= true;
+
+		bool isAlphaTest = false;
+		if(!mat.textures.albedo.empty())
+		{
+			const auto alpha = m_texConvert.getAlphaMode(mat.textures.albedo);
+			if (alpha == ImageProbe::AlphaMode::Blend || (alpha == ImageProbe::AlphaMode::Mask && !SeparateAlphaTest))
+				isTransparent |= true;
+			else if (alpha == ImageProbe::AlphaMode::Mask)
+				isAlphaTest = true;
+		}
 
 		// forced by user
 		if (m_transparentMaterials.find(mat.name) != m_transparentMaterials.end())
@@ -436,8 +1219,8 @@ std::vector<hrsf::Material> Converter::getMaterials() const
 
 		if (isTransparent)
 			mat.data.flags |= hrsf::MaterialData::Transparent;
-
-		Console::progress("materials", res.size(), m_materials.size());
+		else if (isAlphaTest)
+			m_alphaTestMaterials.insert(uint32_t(i));
 	}
 
 	// add default material fallback (if some shape had no material it will use this)
@@ -448,6 +1231,353 @@ std::vector<hrsf::Material> Converter::getMaterials() const
 	return res;
 }
 
+void Converter::buildAtlases()
+{
+	Console::info("building texture atlases");
+	m_uvTransforms.clear();
+	m_atlasTextures.clear();
+	m_atlasTexturesPacked = 0;
+
+	// small textures that are the only texture of their material
+	static constexpr int maxTextureSize = 256;
+	const auto noWrapping = getMaterialsWithoutWrapping();
+	const auto used = getUsedMaterials();
+
+	// the same texture might be used by multiple materials
+	std::map<std::string, std::vector<int>> candidates;
+	for(size_t i = 0; i < m_materials.size(); ++i)
+	{
+		const auto& m = m_materials[i];
+		if (m.diffuse_texname.empty() || !noWrapping[i] || !used[i]) continue;
+		if (!m.alpha_texname.empty() || !m.specular_texname.empty() || !m.bump_texname.empty() ||
+			!m.normal_texname.empty() || !m.roughness_texname.empty() || !m.metallic_texname.empty() ||
+			!m.ambient_texname.empty()) continue;
+
+		int width, height;
+		if (!Image::readSize(m_srcDirectory / m.diffuse_texname, width, height)) continue;
+		if (width > maxTextureSize || height > maxTextureSize) continue;
+
+		candidates[m.diffuse_texname].push_back(int(i));
+	}
+
+	// an atlas only makes sense for multiple textures
+	if (candidates.size() < 2) return;
+
+	struct Candidate
+	{
+		std::string filename;
+		Image image;
+		ImageProbe::AlphaMode alpha = ImageProbe::AlphaMode::Opaque;
+		bool valid = false;
+	};
+	std::vector<Candidate> textures;
+	textures.reserve(candidates.size());
+	for (const auto& c : candidates)
+		textures.push_back({ c.first });
+
+	std::for_each(std::execution::par, textures.begin(), textures.end(), [this](Candidate& c)
+	{
+		try
+		{
+			c.image = Image::load(m_srcDirectory / c.filename);
+			c.alpha = ImageProbe::classifyAlpha(c.image);
+			c.valid = true;
+		}
+		catch (const std::exception&)
+		{
+			// will be converted without atlas
+		}
+	});
+
+	// textures with different alpha modes are not packed together to keep the material classification
+	std::map<ImageProbe::AlphaMode, std::vector<Candidate*>> groups;
+	for (auto& c : textures)
+		if (c.valid) groups[c.alpha].push_back(&c);
+
+	static const char* modeNames[] = { "opaque", "mask", "blend" };
+	for(auto& group : groups)
+	{
+		if (group.second.size() < 2) continue;
+
+		TextureAtlas atlas(AtlasSize);
+		std::vector<size_t> ids;
+		for (auto c : group.second)
+			ids.push_back(atlas.add(std::move(c->image)));
+		atlas.build();
+
+		std::vector<std::filesystem::path> pages;
+		for(auto& page : atlas.getPages())
+		{
+			const auto name = std::string("atlas_") + modeNames[size_t(group.first)] + "_" + std::to_string(pages.size());
+			pages.push_back(m_texConvert.convertImage(std::move(page), name, TextureConverter::Type::Color, TextureAtlas::MaxMipmaps));
+		}
+
+		for(size_t i = 0; i < ids.size(); ++i)
+		{
+			const auto& p = atlas.getPlacement(ids[i]);
+			for(auto materialId : candidates[group.second[i]->filename])
+			{
+				m_uvTransforms[materialId] = { { p.scale[0], p.scale[1] }, { p.offset[0], p.offset[1] } };
+				m_atlasTextures[materialId] = pages[p.page];
+			}
+		}
+		m_atlasTexturesPacked += ids.size();
+
+		Console::info("packed " + std::to_string(ids.size()) + " " + modeNames[size_t(group.first)] + " textures into " + std::to_string(pages.size()) + " atlas pages");
+	}
+}
+
+std::vector<bool> Converter::getMaterialsWithoutWrapping() const
+{
+	static constexpr float epsilon = 0.001f;
+	std::vector<bool> res(m_materials.size(), true);
+	for(const auto& s : m_shapes)
+	{
+		// shapes without triangulated faces (material ids only)
+		if (s.mesh.indices.size() != s.mesh.material_ids.size() * 3)
+			continue;
+
+		for(size_t face = 0; face < s.mesh.material_ids.size(); ++face)
+		{
+			const auto materialId = s.mesh.material_ids[face];
+			if (materialId < 0 || !res[materialId]) continue;
+
+			for(size_t v = 0; v < 3; ++v)
+			{
+				const auto idx = s.mesh.indices[face * 3 + v].texcoord_index;
+				bool inside = idx >= 0 && UseTexcoords;
+				for (int c = 0; c < 2 && inside; ++c)
+				{
+					const auto t = m_attrib.texcoords[2 * idx + c];
+					inside = t >= -epsilon && t <= 1.0f + epsilon;
+				}
+				if (!inside) res[materialId] = false;
+			}
+		}
+	}
+	return res;
+}
+
+void Converter::saveMaterialExtensions(const std::filesystem::path& dst) const
+{
+	using json = nlohmann::json;
+
+	// paths are relative to the scene file
+	auto getRelative = [&dst](const std::filesystem::path& p)
+	{
+		return std::filesystem::relative(p, dst.parent_path()).generic_u8string();
+	};
+
+	json materials = json::object();
+	for(const auto& ext : m_materialExtensions)
+	{
+		if (ext.empty()) continue;
+		json m = json::object();
+		if (!ext.normal.empty())
+			m["normal"] = getRelative(ext.normal);
+		if(!ext.packed.empty())
+		{
+			json channels = json::object();
+			for (const auto& c : ext.packedChannels)
+				channels[c.first] = std::string(1, c.second);
+			m["packed"] = { {"texture", getRelative(ext.packed)}, {"channels", channels} };
+		}
+		materials[ext.name] = m;
+	}
+	if (materials.empty()) return;
+
+	auto filename = dst;
+	filename += ".materials.json";
+	Console::info("writing material extensions to " + filename.string());
+	std::ofstream file(filename);
+	if (!file.is_open())
+		throw std::runtime_error("could not write " + filename.string());
+	file << json{ {"materials", materials} }.dump(1, '\t');
+}
+
+std::vector<float> Converter::getMaterialUvDensity() const
+{
+	std::vector<double> uvArea(m_materials.size(), 0.0);
+	std::vector<double> worldArea(m_materials.size(), 0.0);
+
+	auto triangleArea = [](const float* a, const float* b, const float* c, int dim)
+	{
+		double e1[3] = {}, e2[3] = {};
+		for(int i = 0; i < dim; ++i)
+		{
+			e1[i] = double(b[i]) - double(a[i]);
+			e2[i] = double(c[i]) - double(a[i]);
+		}
+		const double cross[] = {
+			e1[1] * e2[2] - e1[2] * e2[1],
+			e1[2] * e2[0] - e1[0] * e2[2],
+			e1[0] * e2[1] - e1[1] * e2[0]
+		};
+		return 0.5 * std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+	};
+
+	for(const auto& s : m_shapes)
+	{
+		// shapes without triangulated faces (material ids only)
+		if (s.mesh.indices.size() != s.mesh.material_ids.size() * 3)
+			continue;
+
+		for(size_t face = 0; face < s.mesh.material_ids.size(); ++face)
+		{
+			const auto materialId = s.mesh.material_ids[face];
+			const auto* idx = &s.mesh.indices[face * 3];
+			if (materialId < 0 || idx[0].texcoord_index < 0 || idx[1].texcoord_index < 0 || idx[2].texcoord_index < 0)
+				continue;
+
+			worldArea[materialId] += triangleArea(
+				&m_attrib.vertices[3 * idx[0].vertex_index],
+				&m_attrib.vertices[3 * idx[1].vertex_index],
+				&m_attrib.vertices[3 * idx[2].vertex_index], 3);
+			uvArea[materialId] += triangleArea(
+				&m_attrib.texcoords[2 * idx[0].texcoord_index],
+				&m_attrib.texcoords[2 * idx[1].texcoord_index],
+				&m_attrib.texcoords[2 * idx[2].texcoord_index], 2);
+		}
+	}
+
+	std::vector<float> res(m_materials.size(), 0.0f);
+	for(size_t i = 0; i < res.size(); ++i)
+	{
+		if (worldArea[i] > 0.0 && uvArea[i] > 0.0)
+			res[i] = float(std::sqrt(uvArea[i] / worldArea[i]));
+	}
+	return res;
+}
+
+TextureConverter::Limits Converter::getTextureLimits(const std::string& role, float uvDensity) const
+{
+	TextureConverter::Limits limits;
+	limits.maxSize = MaxTextureSize;
+	auto budget = m_textureBudgets.find(role);
+	if (budget != m_textureBudgets.end() && (limits.maxSize == 0 || budget->second < limits.maxSize))
+		limits.maxSize = budget->second;
+
+	if(TexelDensity > 0.0f && uvDensity > 0.0f)
+	{
+		// texels along one texcoord unit that are required for the target density
+		const float required = TexelDensity / uvDensity;
+		// smallest power of two that satisfies the density (small mipmaps are always kept)
+		int size = 4;
+		while (float(size) < required && size < (1 << 16))
+			size *= 2;
+		limits.maxMipSize = size;
+	}
+
+	return limits;
+}
+
+void Converter::mergeMaterials(const std::vector<hrsf::Material>& materials)
+{
+	Console::info("merging identical materials");
+
+	// everything that is used for the material except the name
+	auto isEqual = [this](const hrsf::Material& a, const hrsf::Material& b, size_t ia, size_t ib)
+	{
+		if (std::memcmp(&a.data, &b.data, sizeof(hrsf::MaterialData)) != 0) return false;
+		if (a.textures.albedo != b.textures.albedo || a.textures.coverage != b.textures.coverage || a.textures.specular != b.textures.specular) return false;
+		if (m_alphaTestMaterials.count(uint32_t(ia)) != m_alphaTestMaterials.count(uint32_t(ib))) return false;
+		if (ia < m_materialExtensions.size() && ib < m_materialExtensions.size())
+		{
+			const auto& ea = m_materialExtensions[ia];
+			const auto& eb = m_materialExtensions[ib];
+			if (ea.normal != eb.normal || ea.packed != eb.packed || ea.packedChannels != eb.packedChannels) return false;
+		}
+		// texcoords of atlas materials are transformed differently
+		return m_uvTransforms.count(int(ia)) == 0 && m_uvTransforms.count(int(ib)) == 0;
+	};
+
+	auto getHash = [this](const hrsf::Material& m, size_t index)
+	{
+		XXHash64 hash;
+		hash.update(&m.data, sizeof(hrsf::MaterialData));
+		for(const auto& tex : { m.textures.albedo, m.textures.coverage, m.textures.specular })
+		{
+			const auto str = tex.u8string();
+			hash.update(str.data(), str.size() + 1);
+		}
+		if(index < m_materialExtensions.size())
+		{
+			const auto normal = m_materialExtensions[index].normal.u8string();
+			hash.update(normal.data(), normal.size() + 1);
+			const auto packed = m_materialExtensions[index].packed.u8string();
+			hash.update(packed.data(), packed.size() + 1);
+		}
+		return hash.digest();
+	};
+
+	// the default material (last) is not merged
+	std::vector<int> remap(materials.size());
+	std::unordered_map<uint64_t, std::vector<size_t>> unique;
+	size_t merged = 0;
+	for(size_t i = 0; i < materials.size(); ++i)
+	{
+		remap[i] = int(i);
+		if (i + 1 == materials.size()) break;
+
+		auto& candidates = unique[getHash(materials[i], i)];
+		auto it = std::find_if(candidates.begin(), candidates.end(), [&](size_t c)
+		{
+			return isEqual(materials[c], materials[i], c, i);
+		});
+		if (it == candidates.end())
+			candidates.push_back(i);
+		else
+		{
+			remap[i] = int(*it);
+			++merged;
+		}
+	}
+	if (merged == 0) return;
+
+	for(auto& s : m_shapes)
+		for (auto& id : s.mesh.material_ids)
+			if (id >= 0 && size_t(id) < remap.size()) id = remap[id];
+
+	m_materialsMerged += merged;
+	Console::info("merged " + std::to_string(merged) + " materials");
+}
+
+hrsf::MaterialData Converter::getMaterialData(const tinyobj::material_t& m)
+{
+	auto data = hrsf::MaterialData::Default();
+	std::copy(m.diffuse, m.diffuse + 3, glm::value_ptr(data.albedo));
+	data.specular = (m.specular[0] + m.specular[1] + m.specular[2]) / 3.0f;
+	data.coverage = m.dissolve;
+	std::copy(m.emission, m.emission + 3, glm::value_ptr(data.emission));
+	data.translucency = (m.transmittance[0] + m.transmittance[1] + m.transmittance[2]) / 3.0f;
+	data.metalness = m.metallic;
+	data.ior = m.ior;
+	if(m.roughness != 0.0f)
+	{
+		data.roughness = m.roughness;
+	}
+	else
+	{
+		// map shininess to roughness
+		data.roughness = sqrt(2.0f / (m.shininess + 2.0f));
+	}
+	data.flags = 0;
+
+	//if (m.illum >= 3) // raytrace on flag
+		//data.flags |= hrsf::MaterialData::Flags::Reflection;
+
+	return data;
+}
+
+std::vector<bool> Converter::getUsedMaterials() const
+{
+	std::vector<bool> res(m_materials.size(), false);
+	for (const auto& s : m_shapes)
+		for (auto id : s.mesh.material_ids)
+			if (id >= 0 && size_t(id) < res.size()) res[id] = true;
+	return res;
+}
+
 hrsf::Environment Converter::getEnvironment() const
 {
 	hrsf::Environment e;
@@ -464,17 +1594,37 @@ void Converter::fixPath(std::string& path)
 
 void Converter::printStats() const
 {
+	// goes through the console => lines of parallel batch jobs do not interleave
 	if(m_normalsGenerated)
-		std::cerr << "generated " << m_normalsGenerated << " normals\n";
+		Console::info("generated " + std::to_string(m_normalsGenerated) + " normals");
 	if (m_texcoordsGenerated)
-		std::cerr << "generated " << m_texcoordsGenerated << " texcoords\n";
+		Console::info("generated " + std::to_string(m_texcoordsGenerated) + " texcoords");
 
 	if (m_verticesRemoved)
-		std::cerr << "removed " << m_verticesRemoved << " vertices\n";
+		Console::info("removed " + std::to_string(m_verticesRemoved) + " vertices");
 	if (m_normalsRemoved)
-		std::cerr << "removed " << m_normalsRemoved << " normals\n";
+		Console::info("removed " + std::to_string(m_normalsRemoved) + " normals");
 	if (m_texcoordsRemoved)
-		std::cerr << "removed " << m_texcoordsRemoved << " texcoords\n";
+		Console::info("removed " + std::to_string(m_texcoordsRemoved) + " texcoords");
+
+	if (m_spill)
+	{
+		std::string text = "estimated peak mesh memory " + std::to_string(m_peakMemory / (1024 * 1024)) + " MB";
+		if (MemoryBudget > 0) text += " (budget " + std::to_string(MemoryBudget) + " MB)";
+		Console::info(text);
+	}
+	if (m_emittersExtracted)
+		Console::info("extracted " + std::to_string(m_emittersExtracted) + " emissive triangles");
+	if (m_materialsMerged)
+		Console::info("merged " + std::to_string(m_materialsMerged) + " identical materials");
+	if (m_texturesPacked)
+		Console::info("packed scalar maps of " + std::to_string(m_texturesPacked) + " materials");
+	if (m_bumpMapsConverted)
+		Console::info("converted " + std::to_string(m_bumpMapsConverted) + " bump maps to normal maps");
+	if (m_atlasTexturesPacked)
+		Console::info("packed " + std::to_string(m_atlasTexturesPacked) + " textures into atlases");
+	if (m_texConvert.getNumDuplicates())
+		Console::info("merged " + std::to_string(m_texConvert.getNumDuplicates()) + " duplicate textures (saved " + std::to_string(m_texConvert.getDuplicateBytesSaved()) + " bytes)");
 }
 
 void Converter::removeComponent(hrsf::Component component)
@@ -487,6 +1637,15 @@ void Converter::setTransparentMaterial(const std::string& name)
 	m_transparentMaterials.insert(name);
 }
 
+void Converter::setTextureBudget(const std::string& role, int maxSize)
+{
+	if (role != "albedo" && role != "coverage" && role != "specular" && role != "normal" && role != "packed")
+		throw std::runtime_error("unknown texture role " + role);
+	if (maxSize <= 0)
+		throw std::runtime_error("texture budget must be positive");
+	m_textureBudgets[role] = maxSize;
+}
+
 TextureConverter& Converter::getTexConverter()
 {
 	return m_texConvert;
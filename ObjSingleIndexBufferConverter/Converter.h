@@ -8,14 +8,23 @@
 #include <hrsf/SceneFormat.h>
 #include "TextureConverter.h"
 #include <unordered_set>
+#include <memory>
 
 using namespace prop;
 
+class MeshSpill;
+class SceneList;
+
 class Converter
 {
 public:
 	Converter();
+	~Converter();
+	/// \brief converts the obj (or ply) file. A scene list (.json) merges all of its inputs into one scene
 	void convert(std::filesystem::path src, std::filesystem::path dst);
+	/// \brief converts the scene and keeps converting it whenever the obj, mtl or texture files change.
+	/// Only the affected parts are redone. Does not return
+	void watch(std::filesystem::path src, std::filesystem::path dst);
 	
 	void printStats() const;
 	void setAxisFlips(std::vector<int> flips) { m_flips = move(flips); }
@@ -23,6 +32,8 @@ public:
 	hrsf::Component OutComponents = hrsf::Component::All;
 	void removeComponent(hrsf::Component component);
 	void setTransparentMaterial(const std::string& name);
+	/// \brief sets the maximum resolution for one texture role (albedo, coverage, specular, normal, packed)
+	void setTextureBudget(const std::string& role, int maxSize);
 
 	TextureConverter& getTexConverter();
 
@@ -33,24 +44,160 @@ public:
 	// reduces duplicate vertices
 	DefaultGetterSetter<bool> RemoveDuplicates;
 	DefaultGetterSetter<bool> GenerateTextures;
+	// use the in-process BCn encoder for textures
+	DefaultGetterSetter<bool> CompressTextures;
+	DefaultGetterSetter<BlockCompression::Quality> TextureQuality;
+	// write textures as ktx2 instead of dds
+	DefaultGetterSetter<bool> UseKtx2;
+	// zlib supercompression for ktx2 textures
+	DefaultGetterSetter<bool> SupercompressTextures;
+	// materials with a binary albedo alpha are put into a separate alpha tested mesh instead of the transparent mesh
+	DefaultGetterSetter<bool> SeparateAlphaTest;
 	DefaultGetterSetter<float> RemoveTolerance;
+	// size of the texture atlas pages for small albedo textures (0 = no atlas)
+	DefaultGetterSetter<int> AtlasSize;
+	// maximum texture resolution (longest side) for all textures (0 = unlimited)
+	DefaultGetterSetter<int> MaxTextureSize;
+	// required texels per world unit. Top mipmaps that exceed this density are skipped (0 = keep all)
+	DefaultGetterSetter<float> TexelDensity;
+	// materials with identical parameters and textures are merged
+	DefaultGetterSetter<bool> MergeMaterials;
+	// writes all emissive triangles with an alias table to <dst>.emitters
+	DefaultGetterSetter<bool> ExtractEmitters;
+	// packs occlusion, roughness, metalness and specular maps of a material into one rgba texture
+	DefaultGetterSetter<bool> PackChannels;
+	// reads the parsed obj from <src>.objcache if it is up to date and writes it otherwise
+	DefaultGetterSetter<bool> UseObjCache;
+	// shapes are converted while the obj is parsed and written to a temporary file (bounds the peak memory)
+	DefaultGetterSetter<bool> StreamShapes;
+	// maximum estimated memory in MB for the streaming conversion (0 = unlimited)
+	DefaultGetterSetter<int> MemoryBudget;
 private:
 	void load(std::filesystem::path src);
+	/// \brief loads the inputs of the list in parallel and merges them
+	void load(const SceneList& list);
+	/// \brief appends the geometry and materials that were loaded by another converter
+	/// \param transform is applied to positions and normals
+	/// \param root texture paths are made relative to this directory
+	void append(Converter&& part, const glm::mat4& transform, const std::filesystem::path& root);
 	void save(std::filesystem::path dst);
+	TextureConverter::Settings getTextureSettings() const;
+
+	// watch mode
+	/// \brief mtl files referenced by the obj (mtllib)
+	static std::vector<std::filesystem::path> findMtlFiles(const std::filesystem::path& src);
+	/// \brief reloads the mtl files without parsing the obj again
+	/// \return false if the materials of the shapes could not be matched by name (=> obj must be reloaded)
+	bool reloadMaterials();
+	/// \brief obj, mtl and texture files
+	std::vector<std::filesystem::path> getWatchedFiles(const std::filesystem::path& src) const;
+	/// \brief hash of everything besides the obj geometry that changes the meshes
+	uint64_t getMeshSignature(const std::vector<hrsf::Material>& materials) const;
 
 	std::vector<hrsf::Mesh> convertMesh(const std::vector<hrsf::Material>& materials) const;
+	/// \brief converts a single shape into (possibly multiple) 16 bit meshes
+	/// \param defaultMaterial material id for faces without material
+	void convertShape(const tinyobj::shape_t& s, uint32_t defaultMaterial, std::vector<bmf::BinaryMesh16>& out) const;
+	/// \brief removes duplicate vertices, generates missing attributes and applies the axis flips
+	void processMesh(bmf::BinaryMesh16& m, const std::vector<std::unique_ptr<bmf::VertexGenerator>>& generators) const;
+	uint32_t getRequestedAttributes() const;
+	static std::vector<std::unique_ptr<bmf::VertexGenerator>> createGenerators();
+	/// \return 0 = opaque, 1 = alpha tested, 2 = transparent
+	int getMeshBucket(uint32_t materialId, const std::vector<hrsf::Material>& materials) const;
+
+	/// \brief obj line keywords that are not required for the enabled components and attributes
+	std::vector<std::string> getSkippedKeywords() const;
+	/// \brief parses the obj shape by shape without the lines of getSkippedKeywords().
+	/// \param stream each shape is converted and written to m_spill as soon as it is complete.
+	/// Only the material ids of the shapes are kept in m_shapes
+	void parseObj(const std::filesystem::path& src, bool stream);
+	/// \brief adds the shape to m_shapes or converts it and keeps only its material ids (streaming)
+	void flushShape(tinyobj::shape_t& shape, const std::vector<std::unique_ptr<bmf::VertexGenerator>>& generators);
+	/// \brief merges the meshes from m_spill bucket by bucket
+	std::vector<hrsf::Mesh> mergeSpilledMeshes(const std::vector<hrsf::Material>& materials);
+	/// \brief updates the peak memory estimate. throws if the memory budget is exceeded
+	void trackMemory(uint64_t bytes, const char* stage);
 	hrsf::Camera getCamera() const;
 	std::vector<hrsf::Light> getLights() const;
-	std::vector<hrsf::Material> getMaterials() const;
+	std::vector<hrsf::Material> getMaterials();
 	hrsf::Environment getEnvironment() const;
+	/// \brief redirects the material ids of all shapes from materials that are identical to a previous material.
+	/// The duplicates are removed later by removeUnusedMaterials()
+	void mergeMaterials(const std::vector<hrsf::Material>& materials);
+	/// \brief material properties without textures
+	static hrsf::MaterialData getMaterialData(const tinyobj::material_t& m);
+	/// \brief packs small albedo-only textures of materials into texture atlases
+	void buildAtlases();
+	/// \return indicates for each material if it is referenced by any shape
+	std::vector<bool> getUsedMaterials() const;
+	/// \return indicates for each material if all texcoords of its faces are inside [0, 1]
+	std::vector<bool> getMaterialsWithoutWrapping() const;
+	/// \return average texcoord units per world unit for each material (0 if unknown)
+	std::vector<float> getMaterialUvDensity() const;
+	/// \brief writes textures that are not part of the hrsf material (e.g. normal maps) to <dst>.materials.json
+	void saveMaterialExtensions(const std::filesystem::path& dst) const;
+	/// \brief resolution limits for a texture of the material
+	TextureConverter::Limits getTextureLimits(const std::string& role, float uvDensity) const;
 
 	static void fixPath(std::string& path);
+	static void fixMaterialPaths(tinyobj::material_t& m);
+	/// \brief all texture filenames of the material
+	static std::vector<std::string*> getTextureNames(tinyobj::material_t& m);
 private:
 	tinyobj::attrib_t m_attrib;
 	std::vector<tinyobj::shape_t> m_shapes;
 	std::vector<tinyobj::material_t> m_materials;
 	std::unordered_set<std::string> m_transparentMaterials;
+	// texture role => max size
+	std::unordered_map<std::string, int> m_textureBudgets;
+	// material ids (set by getMaterials()) that require alpha testing
+	std::unordered_set<uint32_t> m_alphaTestMaterials;
 	std::vector<int> m_flips;
+	std::filesystem::path m_srcDirectory;
+
+	struct UvTransform
+	{
+		float scale[2];
+		float offset[2];
+	};
+	// material id => texcoord transformation into the atlas
+	std::unordered_map<int, UvTransform> m_uvTransforms;
+	// material id => atlas texture that replaces the albedo texture
+	std::unordered_map<int, std::filesystem::path> m_atlasTextures;
+	size_t m_atlasTexturesPacked = 0;
+
+	// material data that cannot be stored in the hrsf material
+	struct MaterialExtension
+	{
+		std::string name;
+		// tangent space normal map (converted from the bump map if necessary)
+		std::filesystem::path normal;
+		// packed scalar maps
+		std::filesystem::path packed;
+		// channel name (occlusion, roughness, metalness, specular) => r, g, b or a
+		std::vector<std::pair<std::string, char>> packedChannels;
+
+		bool empty() const { return normal.empty() && packed.empty(); }
+	};
+	// set by getMaterials()
+	std::vector<MaterialExtension> m_materialExtensions;
+	size_t m_bumpMapsConverted = 0;
+	size_t m_texturesPacked = 0;
+	size_t m_materialsMerged = 0;
+	size_t m_emittersExtracted = 0;
+
+	// watch mode: material ids of the obj (before merging)
+	std::vector<std::vector<int>> m_sourceMaterialIds;
+	std::vector<std::filesystem::path> m_mtlFiles;
+	// meshes of the last save() and their signature
+	std::vector<hrsf::Mesh> m_meshCache;
+	uint64_t m_meshSignature = 0;
+	bool m_keepMeshes = false;
+
+	// streaming conversion: converted meshes of all shapes
+	std::unique_ptr<MeshSpill> m_spill;
+	size_t m_numStreamedIndices = 0;
+	uint64_t m_peakMemory = 0;
 
 	size_t m_normalsGenerated = 0;
 	size_t m_texcoordsGenerated = 0;
@@ -0,0 +1,148 @@
+#include "DdsWriter.h"
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	struct DdsPixelFormat
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t rgbBitCount;
+		uint32_t rBitMask;
+		uint32_t gBitMask;
+		uint32_t bBitMask;
+		uint32_t aBitMask;
+	};
+
+	struct DdsHeader
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		DdsPixelFormat pixelFormat;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+
+	struct DdsHeaderDx10
+	{
+		uint32_t dxgiFormat;
+		uint32_t resourceDimension;
+		uint32_t miscFlag;
+		uint32_t arraySize;
+		uint32_t miscFlags2;
+	};
+
+	static_assert(sizeof(DdsHeader) == 124);
+	static_assert(sizeof(DdsHeaderDx10) == 20);
+
+	constexpr uint32_t makeFourCC(char a, char b, char c, char d)
+	{
+		return uint32_t(a) | (uint32_t(b) << 8) | (uint32_t(c) << 16) | (uint32_t(d) << 24);
+	}
+}
+
+DdsWriter::DdsWriter(const std::filesystem::path& filename, DxgiFormat format, int width, int height, int numMipmaps)
+{
+	size_t fileSize = sizeof(uint32_t) + sizeof(DdsHeader) + sizeof(DdsHeaderDx10);
+	for (int i = 0; i < numMipmaps; ++i)
+		fileSize += getMipmapSize(format, std::max(width >> i, 1), std::max(height >> i, 1));
+	m_file = std::make_unique<MappedFile>(filename, fileSize);
+
+	DdsHeader header = {};
+	header.size = sizeof(DdsHeader);
+	// caps | height | width | pixelformat | mipmapcount
+	header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;
+	header.height = uint32_t(height);
+	header.width = uint32_t(width);
+	header.mipMapCount = uint32_t(numMipmaps);
+	if(isBlockCompressed(format))
+	{
+		header.flags |= 0x80000; // linear size
+		header.pitchOrLinearSize = uint32_t(getMipmapSize(format, width, height));
+	}
+	else
+	{
+		header.flags |= 0x8; // pitch
+		header.pitchOrLinearSize = uint32_t(width * 4);
+	}
+	header.pixelFormat.size = sizeof(DdsPixelFormat);
+	header.pixelFormat.flags = 0x4; // fourCC
+	header.pixelFormat.fourCC = makeFourCC('D', 'X', '1', '0');
+	// texture | complex | mipmap
+	header.caps = 0x1000 | 0x8 | 0x400000;
+
+	DdsHeaderDx10 dx10 = {};
+	dx10.dxgiFormat = format;
+	dx10.resourceDimension = 3; // texture 2D
+	dx10.arraySize = 1;
+
+	const auto magic = makeFourCC('D', 'D', 'S', ' ');
+	std::memcpy(m_file->getData(), &magic, sizeof(magic));
+	std::memcpy(m_file->getData() + sizeof(magic), &header, sizeof(header));
+	std::memcpy(m_file->getData() + sizeof(magic) + sizeof(header), &dx10, sizeof(dx10));
+	m_offset = sizeof(magic) + sizeof(header) + sizeof(dx10);
+}
+
+void DdsWriter::writeMipmap(const uint8_t* data, size_t size)
+{
+	std::memcpy(beginMipmap(size), data, size);
+	endMipmap();
+}
+
+uint8_t* DdsWriter::beginMipmap(size_t size)
+{
+	if (m_offset + size > m_file->getSize())
+		throw std::runtime_error("could not write dds mipmap: file size exceeded");
+	m_curSize = size;
+	return m_file->getData() + m_offset;
+}
+
+void DdsWriter::endMipmap()
+{
+	m_offset += m_curSize;
+	m_curSize = 0;
+}
+
+void DdsWriter::finish()
+{
+	if (m_offset != m_file->getSize())
+		throw std::runtime_error("could not write dds: missing mipmaps");
+	// unmaps the view => the os writes the remaining pages
+	m_file.reset();
+}
+
+DdsWriter::DxgiFormat DdsWriter::getDxgiFormat(BlockCompression::Format format, bool srgb)
+{
+	switch (format)
+	{
+	case BlockCompression::Format::BC1: return srgb ? BC1_UNORM_SRGB : BC1_UNORM;
+	case BlockCompression::Format::BC3: return srgb ? BC3_UNORM_SRGB : BC3_UNORM;
+	case BlockCompression::Format::BC5: return BC5_UNORM;
+	case BlockCompression::Format::BC7: return srgb ? BC7_UNORM_SRGB : BC7_UNORM;
+	}
+	throw std::runtime_error("unknown block compression format");
+}
+
+bool DdsWriter::isBlockCompressed(DxgiFormat format)
+{
+	return format >= BC1_UNORM && format <= BC7_UNORM_SRGB;
+}
+
+size_t DdsWriter::getMipmapSize(DxgiFormat format, int width, int height)
+{
+	if (!isBlockCompressed(format))
+		return size_t(width) * size_t(height) * 4;
+	return size_t((width + 3) / 4) * size_t((height + 3) / 4) * (format <= BC1_UNORM_SRGB ? 8 : 16);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <filesystem>
+#include <cstdint>
+#include <memory>
+#include "BlockCompression.h"
+#include "TextureWriter.h"
+#include "MappedFile.h"
+
+// writes a 2D texture with mipmaps into a memory mapped dds file (with DX10 header).
+// Mipmaps can be written directly into the file with beginMipmap() and endMipmap()
+class DdsWriter : public TextureWriter
+{
+public:
+	enum DxgiFormat : uint32_t
+	{
+		R8G8B8A8_UNORM = 28,
+		R8G8B8A8_UNORM_SRGB = 29,
+		BC1_UNORM = 71,
+		BC1_UNORM_SRGB = 72,
+		BC3_UNORM = 77,
+		BC3_UNORM_SRGB = 78,
+		BC5_UNORM = 83,
+		BC7_UNORM = 98,
+		BC7_UNORM_SRGB = 99
+	};
+
+	/// \brief creates the file with its final size and writes the header
+	/// \param numMipmaps number of mipmaps that will be written with writeMipmap()
+	DdsWriter(const std::filesystem::path& filename, DxgiFormat format, int width, int height, int numMipmaps);
+
+	/// \brief appends the next mipmap (largest mipmap first)
+	void writeMipmap(const uint8_t* data, size_t size) override;
+	/// \brief returns the location of the next mipmap inside the mapped file
+	uint8_t* beginMipmap(size_t size) override;
+	void endMipmap() override;
+	void finish() override;
+
+	static DxgiFormat getDxgiFormat(BlockCompression::Format format, bool srgb);
+	static bool isBlockCompressed(DxgiFormat format);
+	/// size in bytes of one mipmap
+	static size_t getMipmapSize(DxgiFormat format, int width, int height);
+private:
+	std::unique_ptr<MappedFile> m_file;
+	size_t m_offset = 0;
+	// size of the mipmap between beginMipmap() and endMipmap()
+	size_t m_curSize = 0;
+};
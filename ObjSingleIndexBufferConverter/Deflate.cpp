@@ -0,0 +1,184 @@
+#include "Deflate.h"
+#include <algorithm>
+
+static constexpr int s_windowSize = 32768;
+static constexpr int s_minMatch = 3;
+static constexpr int s_maxMatch = 258;
+static constexpr int s_hashBits = 15;
+
+static const uint16_t s_lengthBase[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t s_lengthExtra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t s_distBase[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t s_distExtra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+namespace
+{
+	// writes bits starting with the least significant bit
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+		void write(uint32_t bits, int count)
+		{
+			m_buffer |= uint64_t(bits) << m_count;
+			m_count += count;
+			while(m_count >= 8)
+			{
+				m_out.push_back(uint8_t(m_buffer));
+				m_buffer >>= 8;
+				m_count -= 8;
+			}
+		}
+
+		// huffman codes are stored with the most significant bit first
+		void writeCode(uint32_t code, int count)
+		{
+			uint32_t reversed = 0;
+			for (int i = 0; i < count; ++i)
+				reversed |= ((code >> i) & 1) << (count - 1 - i);
+			write(reversed, count);
+		}
+
+		void flush()
+		{
+			if (m_count > 0)
+				m_out.push_back(uint8_t(m_buffer));
+			m_buffer = 0;
+			m_count = 0;
+		}
+	private:
+		std::vector<uint8_t>& m_out;
+		uint64_t m_buffer = 0;
+		int m_count = 0;
+	};
+
+	void writeLiteral(BitWriter& w, uint32_t value)
+	{
+		if (value <= 143) w.writeCode(0x30 + value, 8);
+		else if (value <= 255) w.writeCode(0x190 + value - 144, 9);
+		else if (value <= 279) w.writeCode(value - 256, 7);
+		else w.writeCode(0xC0 + value - 280, 8);
+	}
+
+	void writeMatch(BitWriter& w, int length, int distance)
+	{
+		int l = 0;
+		while (l + 1 < 29 && s_lengthBase[l + 1] <= length) ++l;
+		writeLiteral(w, 257 + l);
+		w.write(length - s_lengthBase[l], s_lengthExtra[l]);
+
+		int d = 0;
+		while (d + 1 < 30 && s_distBase[d + 1] <= distance) ++d;
+		w.writeCode(d, 5);
+		w.write(distance - s_distBase[d], s_distExtra[d]);
+	}
+
+	uint32_t hash3(const uint8_t* p)
+	{
+		const uint32_t v = uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16);
+		return (v * 2654435761u) >> (32 - s_hashBits);
+	}
+}
+
+std::vector<uint8_t> Deflate::compress(const uint8_t* data, size_t size, int maxChainLength)
+{
+	std::vector<uint8_t> out;
+	out.reserve(size / 2 + 64);
+	// zlib header: deflate with 32k window, no dictionary
+	out.push_back(0x78);
+	out.push_back(0x01);
+
+	BitWriter w(out);
+	// single final block with fixed huffman codes
+	w.write(1, 1);
+	w.write(1, 2);
+
+	// hash chains (positions relative to the window)
+	std::vector<int64_t> head(size_t(1) << s_hashBits, -1);
+	std::vector<int64_t> prev(s_windowSize, -1);
+	auto insert = [&](size_t pos)
+	{
+		const auto h = hash3(data + pos);
+		prev[pos % s_windowSize] = head[h];
+		head[h] = int64_t(pos);
+	};
+
+	size_t pos = 0;
+	while(pos < size)
+	{
+		int bestLength = 0;
+		int bestDistance = 0;
+		if(pos + s_minMatch <= size)
+		{
+			const int maxLength = int(std::min<size_t>(s_maxMatch, size - pos));
+			int64_t candidate = head[hash3(data + pos)];
+			for(int chain = 0; chain < maxChainLength && candidate >= 0 && int64_t(pos) - candidate <= s_windowSize; ++chain)
+			{
+				const uint8_t* a = data + candidate;
+				const uint8_t* b = data + pos;
+				if(a[bestLength] == b[bestLength])
+				{
+					int length = 0;
+					while (length < maxLength && a[length] == b[length]) ++length;
+					if(length > bestLength)
+					{
+						bestLength = length;
+						bestDistance = int(int64_t(pos) - candidate);
+						if (length == maxLength) break;
+					}
+				}
+				const int64_t next = prev[candidate % s_windowSize];
+				// the slot was overwritten by a newer position
+				if (next >= candidate) break;
+				candidate = next;
+			}
+		}
+
+		if(bestLength >= s_minMatch)
+		{
+			writeMatch(w, bestLength, bestDistance);
+			const size_t end = pos + bestLength;
+			for (; pos < end; ++pos)
+				if (pos + s_minMatch <= size) insert(pos);
+		}
+		else
+		{
+			writeLiteral(w, data[pos]);
+			if (pos + s_minMatch <= size) insert(pos);
+			++pos;
+		}
+	}
+
+	writeLiteral(w, 256); // end of block
+	w.flush();
+
+	const auto adler = adler32(data, size);
+	out.push_back(uint8_t(adler >> 24));
+	out.push_back(uint8_t(adler >> 16));
+	out.push_back(uint8_t(adler >> 8));
+	out.push_back(uint8_t(adler));
+	return out;
+}
+
+uint32_t Deflate::adler32(const uint8_t* data, size_t size)
+{
+	static constexpr uint32_t mod = 65521;
+	// largest block without overflow
+	static constexpr size_t blockSize = 5552;
+	uint32_t a = 1, b = 0;
+	while(size > 0)
+	{
+		const size_t n = std::min(size, blockSize);
+		for (size_t i = 0; i < n; ++i)
+		{
+			a += data[i];
+			b += a;
+		}
+		a %= mod;
+		b %= mod;
+		data += n;
+		size -= n;
+	}
+	return (b << 16) | a;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// zlib stream (RFC 1950) encoder with lz77 matching and fixed huffman codes (RFC 1951).
+// The decoder is part of stb_image
+class Deflate
+{
+public:
+	/// \brief compresses the data into a zlib stream
+	/// \param maxChainLength number of previous matches that are checked per position (higher = better and slower)
+	static std::vector<uint8_t> compress(const uint8_t* data, size_t size, int maxChainLength = 32);
+
+	static uint32_t adler32(const uint8_t* data, size_t size);
+};
@@ -0,0 +1,135 @@
+#include "EmitterTable.h"
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <fstream>
+#include <cmath>
+#include <stdexcept>
+
+static constexpr uint32_t s_magic = 0x54494D45; // "EMIT"
+static constexpr uint32_t s_version = 1;
+
+namespace
+{
+	struct Face
+	{
+		const tinyobj::index_t* indices;
+		int material;
+	};
+}
+
+EmitterTable::EmitterTable(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+	const std::vector<tinyobj::material_t>& materials, const std::vector<int>& flips)
+{
+	std::vector<bool> isEmissive(materials.size());
+	for (size_t i = 0; i < materials.size(); ++i)
+		isEmissive[i] = materials[i].emission[0] > 0.0f || materials[i].emission[1] > 0.0f || materials[i].emission[2] > 0.0f;
+	if (std::none_of(isEmissive.begin(), isEmissive.end(), [](bool b) { return b; })) return;
+
+	std::vector<Face> faces;
+	for(const auto& s : shapes)
+	{
+		for(size_t f = 0; f < s.mesh.material_ids.size(); ++f)
+		{
+			const auto id = s.mesh.material_ids[f];
+			if (id >= 0 && size_t(id) < materials.size() && isEmissive[id])
+				faces.push_back({ &s.mesh.indices[f * 3], id });
+		}
+	}
+
+	m_emitters.resize(faces.size());
+	std::transform(std::execution::par, faces.begin(), faces.end(), m_emitters.begin(), [&](const Face& face)
+	{
+		Emitter e;
+		float* dst[] = { e.v0, e.v1, e.v2 };
+		for(int v = 0; v < 3; ++v)
+		{
+			std::copy_n(&attrib.vertices[3 * face.indices[v].vertex_index], 3, dst[v]);
+			for (size_t i = 0; i + 1 < flips.size(); i += 2)
+				std::swap(dst[v][flips[i]], dst[v][flips[i + 1]]);
+		}
+
+		const auto& m = materials[face.material];
+		std::copy_n(m.emission, 3, e.radiance);
+
+		float e1[3], e2[3];
+		for(int i = 0; i < 3; ++i)
+		{
+			e1[i] = e.v1[i] - e.v0[i];
+			e2[i] = e.v2[i] - e.v0[i];
+		}
+		const float cross[] = {
+			e1[1] * e2[2] - e1[2] * e2[1],
+			e1[2] * e2[0] - e1[0] * e2[2],
+			e1[0] * e2[1] - e1[1] * e2[0]
+		};
+		e.area = 0.5f * std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+		// lambertian emitter (one sided)
+		static constexpr float pi = 3.14159265358979f;
+		const float luminance = 0.2126f * e.radiance[0] + 0.7152f * e.radiance[1] + 0.0722f * e.radiance[2];
+		e.power = pi * luminance * e.area;
+		return e;
+	});
+
+	// degenerate triangles can not be sampled
+	m_emitters.erase(std::remove_if(m_emitters.begin(), m_emitters.end(), [](const Emitter& e) { return !(e.power > 0.0f); }), m_emitters.end());
+	if (m_emitters.empty()) return;
+
+	m_totalPower = float(std::transform_reduce(std::execution::par, m_emitters.begin(), m_emitters.end(), 0.0, std::plus<>(),
+		[](const Emitter& e) { return double(e.power); }));
+	buildAliasTable();
+}
+
+void EmitterTable::buildAliasTable()
+{
+	const size_t n = m_emitters.size();
+	m_aliasTable.resize(n);
+
+	// scaled probabilities (average = 1)
+	std::vector<double> scaled(n);
+	for (size_t i = 0; i < n; ++i)
+		scaled[i] = double(m_emitters[i].power) * double(n) / double(m_totalPower);
+
+	std::vector<uint32_t> small, large;
+	for(size_t i = 0; i < n; ++i)
+	{
+		if (scaled[i] < 1.0) small.push_back(uint32_t(i));
+		else large.push_back(uint32_t(i));
+	}
+
+	while(!small.empty() && !large.empty())
+	{
+		const auto s = small.back();
+		small.pop_back();
+		const auto l = large.back();
+
+		m_aliasTable[s] = { float(scaled[s]), l };
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+		if(scaled[l] < 1.0)
+		{
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	// remaining entries are 1 (up to rounding errors)
+	for (auto i : large) m_aliasTable[i] = { 1.0f, i };
+	for (auto i : small) m_aliasTable[i] = { 1.0f, i };
+}
+
+void EmitterTable::save(const std::filesystem::path& filename) const
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("could not open " + filename.string() + " for writing");
+
+	const uint32_t count = uint32_t(m_emitters.size());
+	file.write(reinterpret_cast<const char*>(&s_magic), sizeof(s_magic));
+	file.write(reinterpret_cast<const char*>(&s_version), sizeof(s_version));
+	file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	file.write(reinterpret_cast<const char*>(&m_totalPower), sizeof(m_totalPower));
+	file.write(reinterpret_cast<const char*>(m_emitters.data()), std::streamsize(m_emitters.size() * sizeof(Emitter)));
+	file.write(reinterpret_cast<const char*>(m_aliasTable.data()), std::streamsize(m_aliasTable.size() * sizeof(AliasEntry)));
+	if (!file)
+		throw std::runtime_error("could not write " + filename.string());
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+#include "../tinyobj/tiny_obj_loader.h"
+
+// list of emissive triangles with an alias table for power proportional sampling
+class EmitterTable
+{
+public:
+	struct Emitter
+	{
+		float v0[3];
+		float v1[3];
+		float v2[3];
+		// emitted radiance (material emission)
+		float radiance[3];
+		float area;
+		// radiant flux (pi * luminance * area)
+		float power;
+	};
+
+	struct AliasEntry
+	{
+		// probability of choosing this emitter instead of the alias
+		float probability;
+		uint32_t alias;
+	};
+
+	/// \brief collects all triangles with an emissive material. Power computation runs in parallel
+	/// \param flips pairs of position axes that are swapped (same as the mesh)
+	EmitterTable(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+		const std::vector<tinyobj::material_t>& materials, const std::vector<int>& flips);
+
+	size_t size() const { return m_emitters.size(); }
+	bool empty() const { return m_emitters.empty(); }
+	float getTotalPower() const { return m_totalPower; }
+
+	/// \brief binary file: header (magic "EMIT", version, count, total power), emitters, alias table
+	void save(const std::filesystem::path& filename) const;
+private:
+	/// \brief vose alias method
+	void buildAliasTable();
+
+	std::vector<Emitter> m_emitters;
+	std::vector<AliasEntry> m_aliasTable;
+	float m_totalPower = 0.0f;
+};
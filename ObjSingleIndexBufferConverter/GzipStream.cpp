@@ -0,0 +1,235 @@
+#include "GzipStream.h"
+#include <stdexcept>
+#include <execution>
+#include <algorithm>
+#include <numeric>
+#include <array>
+#include <string>
+
+// BGZF members are at most 64 KB => ~16 MB of output per batch
+static constexpr size_t s_batchSize = 256;
+
+enum Flags : uint8_t
+{
+	FHCRC = 2,
+	FEXTRA = 4,
+	FNAME = 8,
+	FCOMMENT = 16
+};
+
+static uint32_t readLE32(const uint8_t* p)
+{
+	return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+GzipStream::GzipStream(std::istream& src)
+	:
+m_src(src),
+m_inflate(src)
+{}
+
+uint32_t GzipStream::crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+	static const auto table = []()
+	{
+		std::array<uint32_t, 256> t;
+		for(uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			t[i] = c;
+		}
+		return t;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+GzipStream::int_type GzipStream::underflow()
+{
+	if (gptr() < egptr())
+		return traits_type::to_int_type(*gptr());
+
+	while(true)
+	{
+		// output of parallel decoded members
+		if(!m_batch.empty())
+		{
+			std::swap(m_batch, m_served);
+			m_batch.clear();
+			char* data = reinterpret_cast<char*>(m_served.data());
+			setg(data, data, data + m_served.size());
+			return traits_type::to_int_type(*data);
+		}
+
+		if(m_streaming)
+		{
+			const auto& output = m_inflate.getOutput();
+			if(m_consumed < output.size())
+			{
+				char* data = const_cast<char*>(reinterpret_cast<const char*>(output.data()));
+				setg(data + m_consumed, data + m_consumed, data + output.size());
+				m_consumed = output.size();
+				return traits_type::to_int_type(*gptr());
+			}
+
+			m_consumed = m_inflate.discardOutput();
+			if(m_inflate.decodeBlock())
+			{
+				const auto& out = m_inflate.getOutput();
+				m_crc = crc32(out.data() + m_consumed, out.size() - m_consumed, m_crc);
+				m_memberSize += out.size() - m_consumed;
+				continue;
+			}
+
+			finishMember();
+			m_streaming = false;
+			continue;
+		}
+
+		Member member;
+		if (!readHeader(member))
+			return traits_type::eof();
+
+		if (member.blockSize)
+			decodeBatch(member);
+		else
+			startMember();
+	}
+}
+
+void GzipStream::startMember()
+{
+	m_inflate.reset();
+	m_streaming = true;
+	m_consumed = 0;
+	m_crc = 0;
+	m_memberSize = 0;
+}
+
+bool GzipStream::readHeader(Member& member)
+{
+	auto read = [&](void* dst, size_t size)
+	{
+		if (m_inflate.readBytes(dst, size) != size)
+			throw std::runtime_error("gzip: unexpected end of file");
+		member.headerSize += size;
+	};
+
+	if (m_inflate.atEnd()) return false;
+
+	uint8_t header[10];
+	read(header, sizeof(header));
+	if (!hasMagic(header, sizeof(header)) || header[2] != 8)
+		throw std::runtime_error("gzip: invalid member header");
+	const auto flags = header[3];
+
+	if(flags & FEXTRA)
+	{
+		uint8_t len[2];
+		read(len, 2);
+		std::vector<uint8_t> extra(len[0] | (len[1] << 8));
+		read(extra.data(), extra.size());
+
+		// subfields: id (2), length (2), data
+		for(size_t i = 0; i + 4 <= extra.size();)
+		{
+			const size_t fieldLength = extra[i + 2] | (extra[i + 3] << 8);
+			if (extra[i] == 'B' && extra[i + 1] == 'C' && fieldLength == 2 && i + 6 <= extra.size())
+				member.blockSize = size_t(extra[i + 4] | (extra[i + 5] << 8)) + 1;
+			i += 4 + fieldLength;
+		}
+	}
+
+	// zero terminated file name and comment
+	for(auto flag : { FNAME, FCOMMENT })
+	{
+		if (!(flags & flag)) continue;
+		uint8_t c;
+		do read(&c, 1); while (c != 0);
+	}
+
+	if(flags & FHCRC)
+	{
+		uint8_t crc[2];
+		read(crc, 2);
+	}
+
+	if (member.blockSize && member.blockSize < member.headerSize + 8)
+		throw std::runtime_error("gzip: invalid BGZF block size");
+	return true;
+}
+
+void GzipStream::finishMember()
+{
+	uint8_t trailer[8];
+	if (m_inflate.readBytes(trailer, 8) != 8)
+		throw std::runtime_error("gzip: unexpected end of file");
+	if (readLE32(trailer) != m_crc)
+		throw std::runtime_error("gzip: crc mismatch");
+	if (readLE32(trailer + 4) != uint32_t(m_memberSize))
+		throw std::runtime_error("gzip: size mismatch");
+}
+
+void GzipStream::decodeBatch(const Member& first)
+{
+	// compressed data + trailer of each member
+	std::vector<std::vector<uint8_t>> members;
+	auto readMember = [&](const Member& m)
+	{
+		members.emplace_back(m.blockSize - m.headerSize);
+		if (m_inflate.readBytes(members.back().data(), members.back().size()) != members.back().size())
+			throw std::runtime_error("gzip: unexpected end of file");
+	};
+
+	readMember(first);
+	bool streamNext = false;
+	while(members.size() < s_batchSize)
+	{
+		Member next;
+		if (!readHeader(next)) break;
+		if(!next.blockSize)
+		{
+			// regular member => decoded after the batch
+			streamNext = true;
+			break;
+		}
+		readMember(next);
+	}
+
+	std::vector<std::vector<uint8_t>> outputs(members.size());
+	// exceptions must not leave the parallel algorithm
+	std::vector<std::string> errors(members.size());
+	std::vector<size_t> indices(members.size());
+	std::iota(indices.begin(), indices.end(), size_t(0));
+	std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t i)
+	{
+		try
+		{
+			const auto& m = members[i];
+			const uint8_t* trailer = m.data() + m.size() - 8;
+			outputs[i] = Inflate::decompress(m.data(), m.size() - 8, readLE32(trailer + 4));
+			if (readLE32(trailer + 4) != uint32_t(outputs[i].size()))
+				throw std::runtime_error("gzip: size mismatch");
+			if (readLE32(trailer) != crc32(outputs[i].data(), outputs[i].size()))
+				throw std::runtime_error("gzip: crc mismatch");
+		}
+		catch(const std::exception& e)
+		{
+			errors[i] = e.what();
+		}
+	});
+	for (const auto& e : errors)
+		if (!e.empty()) throw std::runtime_error(e);
+
+	m_batch.clear();
+	for (const auto& o : outputs)
+		m_batch.insert(m_batch.end(), o.begin(), o.end());
+
+	if (streamNext)
+		startMember();
+}
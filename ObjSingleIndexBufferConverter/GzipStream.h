@@ -0,0 +1,50 @@
+#pragma once
+#include <streambuf>
+#include <istream>
+#include <vector>
+#include <cstdint>
+#include "Inflate.h"
+
+// stream buffer that decompresses gzip data (RFC 1952) while it is read.
+// Multiple members are concatenated. Members in the BGZF format (bgzip) store their compressed size,
+// so batches of them are decompressed in parallel
+class GzipStream : public std::streambuf
+{
+public:
+	explicit GzipStream(std::istream& src);
+
+	static bool hasMagic(const uint8_t* data, size_t size) { return size >= 2 && data[0] == 0x1F && data[1] == 0x8B; }
+
+	static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+protected:
+	int_type underflow() override;
+private:
+	struct Member
+	{
+		// compressed size of a BGZF member (0 = unknown)
+		size_t blockSize = 0;
+		size_t headerSize = 0;
+	};
+
+	/// \brief reads the next member header
+	/// \return false at the end of the input
+	bool readHeader(Member& member);
+	/// \brief starts decoding a regular member with m_inflate
+	void startMember();
+	/// \brief reads the crc and size of the member that was decoded by m_inflate
+	void finishMember();
+	/// \brief decodes the BGZF member and the following ones in parallel into m_batch
+	void decodeBatch(const Member& first);
+
+	std::istream& m_src;
+	Inflate m_inflate;
+	// currently decoding a member with m_inflate
+	bool m_streaming = false;
+	size_t m_consumed = 0;
+	uint32_t m_crc = 0;
+	uint64_t m_memberSize = 0;
+	// output of parallel decoded members
+	std::vector<uint8_t> m_batch;
+	// batch that is currently read
+	std::vector<uint8_t> m_served;
+};
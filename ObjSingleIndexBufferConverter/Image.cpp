@@ -0,0 +1,214 @@
+#include "Image.h"
+#include <stdexcept>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <execution>
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+static float toLinear(float c)
+{
+	if (c <= 0.04045f) return c / 12.92f;
+	return std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t toSrgb(float c)
+{
+	if (c <= 0.0031308f) c *= 12.92f;
+	else c = 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	return uint8_t(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+}
+
+static const std::array<float, 256>& getLinearTable()
+{
+	static const std::array<float, 256> table = []()
+	{
+		std::array<float, 256> t;
+		for (size_t i = 0; i < t.size(); ++i)
+			t[i] = toLinear(float(i) / 255.0f);
+		return t;
+	}();
+	return table;
+}
+
+Image::Image(int width, int height)
+	:
+m_width(width),
+m_height(height),
+m_data(size_t(width) * size_t(height) * 4)
+{}
+
+Image Image::load(const std::filesystem::path& filename)
+{
+	int width, height, channels;
+	auto data = stbi_load(filename.string().c_str(), &width, &height, &channels, 4);
+	if (!data)
+		throw std::runtime_error("could not load " + filename.string() + ": " + stbi_failure_reason());
+
+	Image res(width, height);
+	res.m_srcChannels = channels;
+	std::copy(data, data + res.m_data.size(), res.m_data.begin());
+	stbi_image_free(data);
+
+	return res;
+}
+
+bool Image::readSize(const std::filesystem::path& filename, int& width, int& height)
+{
+	int channels;
+	return stbi_info(filename.string().c_str(), &width, &height, &channels) != 0;
+}
+
+Image Image::generateMipmap(bool srgb) const
+{
+	const auto& linear = getLinearTable();
+	Image res(std::max(m_width / 2, 1), std::max(m_height / 2, 1));
+	res.m_srcChannels = m_srcChannels;
+
+	for(int y = 0; y < res.m_height; ++y)
+	{
+		const int y0 = std::min(y * 2, m_height - 1);
+		const int y1 = std::min(y * 2 + 1, m_height - 1);
+		for(int x = 0; x < res.m_width; ++x)
+		{
+			const int x0 = std::min(x * 2, m_width - 1);
+			const int x1 = std::min(x * 2 + 1, m_width - 1);
+			const uint8_t* src[] = { getPixel(x0, y0), getPixel(x1, y0), getPixel(x0, y1), getPixel(x1, y1) };
+			auto dst = res.getPixel(x, y);
+
+			for(int c = 0; c < 4; ++c)
+			{
+				if(srgb && c < 3)
+				{
+					float sum = 0.0f;
+					for (auto s : src) sum += linear[s[c]];
+					dst[c] = toSrgb(sum * 0.25f);
+				}
+				else
+				{
+					int sum = 0;
+					for (auto s : src) sum += s[c];
+					dst[c] = uint8_t((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	return res;
+}
+
+static float lanczos(float x)
+{
+	static constexpr float lobes = 3.0f;
+	static constexpr float pi = 3.14159265358979f;
+	x = std::abs(x);
+	if (x < 1e-5f) return 1.0f;
+	if (x >= lobes) return 0.0f;
+	return lobes * std::sin(pi * x) * std::sin(pi * x / lobes) / (pi * pi * x * x);
+}
+
+namespace
+{
+	// filter taps of one destination pixel
+	struct Taps
+	{
+		int first;
+		std::vector<float> weights;
+	};
+}
+
+static std::vector<Taps> computeTaps(int srcSize, int dstSize)
+{
+	// widen the filter when minifying
+	const float scale = float(srcSize) / float(dstSize);
+	const float support = 3.0f * std::max(scale, 1.0f);
+	const float invFilterScale = 1.0f / std::max(scale, 1.0f);
+
+	std::vector<Taps> res(dstSize);
+	for(int i = 0; i < dstSize; ++i)
+	{
+		const float center = (float(i) + 0.5f) * scale;
+		const int first = std::max(int(std::floor(center - support)), 0);
+		const int last = std::min(int(std::ceil(center + support)), srcSize - 1);
+
+		auto& t = res[i];
+		t.first = first;
+		float sum = 0.0f;
+		for(int s = first; s <= last; ++s)
+		{
+			t.weights.push_back(lanczos((float(s) + 0.5f - center) * invFilterScale));
+			sum += t.weights.back();
+		}
+		for (auto& w : t.weights) w /= sum;
+	}
+	return res;
+}
+
+Image Image::resize(int width, int height, bool srgb) const
+{
+	const auto& linear = getLinearTable();
+	const auto horizontal = computeTaps(m_width, width);
+	const auto vertical = computeTaps(m_height, height);
+
+	// horizontal pass into a float image (keeps precision for the second pass)
+	std::vector<float> tmp(size_t(width) * size_t(m_height) * 4);
+	std::vector<int> rows(m_height);
+	std::iota(rows.begin(), rows.end(), 0);
+	std::for_each(std::execution::par, rows.begin(), rows.end(), [&](int y)
+	{
+		for(int x = 0; x < width; ++x)
+		{
+			const auto& t = horizontal[x];
+			float* dst = &tmp[(size_t(y) * width + x) * 4];
+			for(size_t i = 0; i < t.weights.size(); ++i)
+			{
+				const uint8_t* src = getPixel(t.first + int(i), y);
+				for (int c = 0; c < 4; ++c)
+					dst[c] += t.weights[i] * (srgb && c < 3 ? linear[src[c]] : float(src[c]) / 255.0f);
+			}
+		}
+	});
+
+	Image res(width, height);
+	res.m_srcChannels = m_srcChannels;
+	rows.resize(height);
+	std::iota(rows.begin(), rows.end(), 0);
+	std::for_each(std::execution::par, rows.begin(), rows.end(), [&](int y)
+	{
+		const auto& t = vertical[y];
+		for(int x = 0; x < width; ++x)
+		{
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for(size_t i = 0; i < t.weights.size(); ++i)
+			{
+				const float* src = &tmp[(size_t(t.first + int(i)) * width + x) * 4];
+				for (int c = 0; c < 4; ++c)
+					sum[c] += t.weights[i] * src[c];
+			}
+
+			auto dst = res.getPixel(x, y);
+			for(int c = 0; c < 4; ++c)
+			{
+				// lanczos has negative lobes => clamp
+				const float v = std::clamp(sum[c], 0.0f, 1.0f);
+				dst[c] = srgb && c < 3 ? toSrgb(v) : uint8_t(v * 255.0f + 0.5f);
+			}
+		}
+	});
+
+	return res;
+}
+
+int Image::computeMipmapCount(int width, int height)
+{
+	int count = 1;
+	while(width > 1 || height > 1)
+	{
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+		++count;
+	}
+	return count;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+
+// 8 bit rgba image that is decoded in-process (png, jpg, tga, bmp, psd...)
+class Image
+{
+public:
+	Image() = default;
+	Image(int width, int height);
+
+	/// \brief loads the image with stb_image. The image is always expanded to 4 channels.
+	/// throws if the file format is not supported
+	static Image load(const std::filesystem::path& filename);
+
+	/// \brief reads the image dimensions from the file header
+	/// \return false if the format is not supported
+	static bool readSize(const std::filesystem::path& filename, int& width, int& height);
+
+	int getWidth() const { return m_width; }
+	int getHeight() const { return m_height; }
+	/// number of channels that were present in the source file (1 - 4)
+	int getSourceChannels() const { return m_srcChannels; }
+	bool empty() const { return m_data.empty(); }
+
+	uint8_t* getData() { return m_data.data(); }
+	const uint8_t* getData() const { return m_data.data(); }
+	uint8_t* getPixel(int x, int y) { return m_data.data() + (size_t(y) * m_width + x) * 4; }
+	const uint8_t* getPixel(int x, int y) const { return m_data.data() + (size_t(y) * m_width + x) * 4; }
+
+	/// \brief generates the next smaller mipmap with a 2x2 box filter
+	/// \param srgb rgb channels will be filtered in linear space
+	Image generateMipmap(bool srgb) const;
+
+	/// \brief resamples the image with a separable lanczos filter (3 lobes). Rows are processed in parallel
+	/// \param srgb rgb channels will be filtered in linear space
+	Image resize(int width, int height, bool srgb) const;
+
+	/// number of mipmaps for a full chain down to 1x1
+	static int computeMipmapCount(int width, int height);
+private:
+	int m_width = 0;
+	int m_height = 0;
+	int m_srcChannels = 4;
+	std::vector<uint8_t> m_data;
+};
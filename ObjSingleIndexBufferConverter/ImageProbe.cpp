@@ -0,0 +1,226 @@
+#include "ImageProbe.h"
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <array>
+#include <execution>
+#include <numeric>
+
+namespace
+{
+	using Histogram = std::array<uint32_t, 256>;
+
+	// alpha values in [s_maskLow, s_maskHigh] are neither transparent nor opaque
+	constexpr uint8_t s_maskLow = 8;
+	constexpr uint8_t s_maskHigh = 247;
+	// fraction of intermediate alpha values that is still considered a binary mask (anti-aliased edges)
+	constexpr float s_maskTolerance = 0.02f;
+	constexpr int s_rowsPerChunk = 64;
+
+	Histogram computeHistogram(const uint8_t* rgba, size_t numPixels)
+	{
+		// four sub histograms to avoid stalls on consecutive increments of the same bin
+		uint32_t counts[4][256] = {};
+		size_t i = 0;
+		for(; i + 4 <= numPixels; i += 4)
+		{
+			++counts[0][rgba[i * 4 + 3]];
+			++counts[1][rgba[i * 4 + 7]];
+			++counts[2][rgba[i * 4 + 11]];
+			++counts[3][rgba[i * 4 + 15]];
+		}
+		for (; i < numPixels; ++i)
+			++counts[0][rgba[i * 4 + 3]];
+
+		Histogram res;
+		for (size_t bin = 0; bin < res.size(); ++bin)
+			res[bin] = counts[0][bin] + counts[1][bin] + counts[2][bin] + counts[3][bin];
+		return res;
+	}
+
+	uint32_t readBigEndian32(const uint8_t* p)
+	{
+		return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+	}
+
+	uint32_t readLittleEndian32(const uint8_t* p)
+	{
+		return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+	}
+
+	ImageProbe::Alpha probePng(std::ifstream& file)
+	{
+		// chunks after the 8 byte signature. The IHDR chunk is always first
+		file.seekg(8);
+		bool isFirst = true;
+		uint8_t chunk[8];
+		while(file.read(reinterpret_cast<char*>(chunk), sizeof(chunk)))
+		{
+			const auto length = readBigEndian32(chunk);
+			const auto type = std::string(reinterpret_cast<const char*>(chunk + 4), 4);
+			if(isFirst)
+			{
+				if (type != "IHDR") return ImageProbe::Alpha::Unknown;
+				uint8_t ihdr[13];
+				if (!file.read(reinterpret_cast<char*>(ihdr), sizeof(ihdr))) return ImageProbe::Alpha::Unknown;
+				const auto colorType = ihdr[9];
+				// 4 = grayscale + alpha, 6 = rgba
+				if (colorType == 4 || colorType == 6) return ImageProbe::Alpha::Channel;
+				// skip crc
+				file.seekg(4, std::ios::cur);
+				isFirst = false;
+				continue;
+			}
+			// transparency chunk must appear before the image data
+			if (type == "tRNS") return ImageProbe::Alpha::Channel;
+			if (type == "IDAT" || type == "IEND") return ImageProbe::Alpha::None;
+			// skip data + crc
+			file.seekg(std::streamoff(length) + 4, std::ios::cur);
+		}
+		return ImageProbe::Alpha::Unknown;
+	}
+
+	ImageProbe::Alpha probeTga(const uint8_t* header)
+	{
+		const auto imageType = header[2] & ~8; // ignore rle flag
+		const auto colorMapDepth = header[7];
+		const auto pixelDepth = header[16];
+		const auto alphaBits = header[17] & 0xF;
+		if (imageType == 1) // color mapped
+			return colorMapDepth == 32 ? ImageProbe::Alpha::Channel : ImageProbe::Alpha::None;
+		if (imageType == 2 || imageType == 3)
+			return (alphaBits || pixelDepth == 32) ? ImageProbe::Alpha::Channel : ImageProbe::Alpha::None;
+		return ImageProbe::Alpha::Unknown;
+	}
+
+	ImageProbe::Alpha probeBmp(const uint8_t* header, size_t size)
+	{
+		if (size < 30) return ImageProbe::Alpha::Unknown;
+		const auto dibSize = readLittleEndian32(header + 14);
+		const auto bitCount = uint32_t(header[28]) | (uint32_t(header[29]) << 8);
+		if (bitCount != 32 && bitCount != 16) return ImageProbe::Alpha::None;
+		// BITMAPV3INFOHEADER and newer contain an alpha mask
+		if (dibSize >= 56 && size >= 14 + 56)
+			return readLittleEndian32(header + 14 + 52) ? ImageProbe::Alpha::Channel : ImageProbe::Alpha::None;
+		return bitCount == 32 ? ImageProbe::Alpha::Channel : ImageProbe::Alpha::None;
+	}
+
+	ImageProbe::Alpha probeDds(const uint8_t* header, size_t size)
+	{
+		if (size < 128) return ImageProbe::Alpha::Unknown;
+		// magic (4) + header offset of DDS_PIXELFORMAT (72)
+		const auto flags = readLittleEndian32(header + 80);
+		const auto fourCC = std::string(reinterpret_cast<const char*>(header + 84), 4);
+		const auto alphaMask = readLittleEndian32(header + 104);
+		if(flags & 0x4) // fourCC
+		{
+			if (fourCC == "DXT1" || fourCC == "DXT2" || fourCC == "DXT3" || fourCC == "DXT4" || fourCC == "DXT5")
+				return ImageProbe::Alpha::Channel;
+			if (fourCC == "ATI1" || fourCC == "ATI2" || fourCC == "BC4U" || fourCC == "BC5U")
+				return ImageProbe::Alpha::None;
+			if (fourCC != "DX10" || size < 148) return ImageProbe::Alpha::Unknown;
+
+			const auto dxgiFormat = readLittleEndian32(header + 128);
+			switch (dxgiFormat)
+			{
+			case 2: // R32G32B32A32
+			case 10: // R16G16B16A16
+			case 11:
+			case 24: // R10G10B10A2
+			case 27: // R8G8B8A8
+			case 28:
+			case 29:
+			case 70: // BC1
+			case 71:
+			case 72:
+			case 73: // BC2
+			case 74:
+			case 75:
+			case 76: // BC3
+			case 77:
+			case 78:
+			case 87: // B8G8R8A8
+			case 90:
+			case 91:
+			case 97: // BC7
+			case 98:
+			case 99:
+				return ImageProbe::Alpha::Channel;
+			default:
+				return ImageProbe::Alpha::None;
+			}
+		}
+		// uncompressed: alpha pixels flag or alpha mask
+		return ((flags & 0x1) || alphaMask) ? ImageProbe::Alpha::Channel : ImageProbe::Alpha::None;
+	}
+}
+
+ImageProbe::Alpha ImageProbe::probeAlpha(const std::filesystem::path& filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open()) return Alpha::Unknown;
+
+	uint8_t header[148] = {};
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	const auto size = size_t(file.gcount());
+	file.clear();
+
+	static const uint8_t pngSignature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (size >= 8 && std::memcmp(header, pngSignature, 8) == 0)
+		return probePng(file);
+	if (size >= 3 && header[0] == 0xFF && header[1] == 0xD8 && header[2] == 0xFF)
+		return Alpha::None; // jpg
+	if (size >= 4 && std::memcmp(header, "DDS ", 4) == 0)
+		return probeDds(header, size);
+	if (size >= 2 && header[0] == 'B' && header[1] == 'M')
+		return probeBmp(header, size);
+
+	// tga has no signature
+	auto extension = filename.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return char(std::tolower(c)); });
+	if (extension == ".tga" && size >= 18)
+		return probeTga(header);
+
+	return Alpha::Unknown;
+}
+
+bool ImageProbe::hasTransparency(const Image& image)
+{
+	const auto data = image.getData();
+	const size_t numPixels = size_t(image.getWidth()) * size_t(image.getHeight());
+	for(size_t i = 0; i < numPixels; ++i)
+	{
+		if (data[i * 4 + 3] != 255)
+			return true;
+	}
+	return false;
+}
+
+ImageProbe::AlphaMode ImageProbe::classifyAlpha(const Image& image)
+{
+	if (!hasTransparency(image))
+		return AlphaMode::Opaque;
+
+	// histogram over chunks of rows
+	std::vector<int> chunks((image.getHeight() + s_rowsPerChunk - 1) / s_rowsPerChunk);
+	std::iota(chunks.begin(), chunks.end(), 0);
+	const auto histogram = std::transform_reduce(std::execution::par, chunks.begin(), chunks.end(), Histogram{},
+		[](Histogram a, const Histogram& b)
+	{
+		for (size_t i = 0; i < a.size(); ++i)
+			a[i] += b[i];
+		return a;
+	}, [&image](int chunk)
+	{
+		const int firstRow = chunk * s_rowsPerChunk;
+		const int numRows = std::min(s_rowsPerChunk, image.getHeight() - firstRow);
+		return computeHistogram(image.getPixel(0, firstRow), size_t(numRows) * image.getWidth());
+	});
+
+	const auto numPixels = size_t(image.getWidth()) * size_t(image.getHeight());
+	const auto numIntermediate = std::accumulate(histogram.begin() + s_maskLow, histogram.begin() + s_maskHigh + 1, size_t(0));
+	if (float(numIntermediate) <= float(numPixels) * s_maskTolerance)
+		return AlphaMode::Mask;
+	return AlphaMode::Blend;
+}
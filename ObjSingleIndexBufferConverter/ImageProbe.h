@@ -0,0 +1,31 @@
+#pragma once
+#include <filesystem>
+#include "Image.h"
+
+// determines the alpha channel of images without decoding them
+class ImageProbe
+{
+public:
+	enum class Alpha
+	{
+		None, // the format has no alpha channel
+		Channel, // the format has an alpha channel (values may still be opaque)
+		Unknown // format could not be probed
+	};
+
+	enum class AlphaMode
+	{
+		Opaque, // all pixels are opaque
+		Mask, // (almost) binary alpha => alpha test
+		Blend // alpha blending required
+	};
+
+	/// \brief reads only the file header (png IHDR/tRNS, tga, bmp, dds, jpg)
+	static Alpha probeAlpha(const std::filesystem::path& filename);
+
+	/// \brief scans the alpha channel and stops at the first pixel that is not fully opaque
+	static bool hasTransparency(const Image& image);
+
+	/// \brief classifies the alpha channel based on its histogram. Rows are processed in parallel
+	static AlphaMode classifyAlpha(const Image& image);
+};
@@ -0,0 +1,326 @@
+#include "Inflate.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+static constexpr size_t s_windowSize = 32768;
+static constexpr size_t s_bufferSize = 1 << 16;
+
+static const uint16_t s_lengthBase[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t s_lengthExtra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t s_distBase[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t s_distExtra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// order of the code length code lengths
+static const uint8_t s_codeLengthOrder[] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+Inflate::Inflate(std::istream& src)
+	:
+m_src(&src),
+m_buffer(s_bufferSize)
+{}
+
+Inflate::Inflate(const uint8_t* data, size_t size)
+	:
+m_in(data),
+m_inEnd(data + size)
+{}
+
+void Inflate::Table::build(const uint8_t* lengths, size_t count)
+{
+	int numCodes[16] = {};
+	maxBits = 0;
+	for(size_t i = 0; i < count; ++i)
+	{
+		++numCodes[lengths[i]];
+		maxBits = std::max(maxBits, int(lengths[i]));
+	}
+	numCodes[0] = 0;
+
+	// first code of each length
+	int nextCode[16] = {};
+	for (int bits = 1, code = 0; bits < 16; ++bits)
+	{
+		code = (code + numCodes[bits - 1]) << 1;
+		nextCode[bits] = code;
+	}
+
+	entries.assign(size_t(1) << maxBits, 0);
+	for(size_t sym = 0; sym < count; ++sym)
+	{
+		const int len = lengths[sym];
+		if (len == 0) continue;
+		const int code = nextCode[len]++;
+		if (code >= (1 << len))
+			throw std::runtime_error("deflate: over-subscribed huffman code");
+
+		// codes are stored with the most significant bit first
+		uint32_t reversed = 0;
+		for (int i = 0; i < len; ++i)
+			reversed |= ((code >> i) & 1) << (len - 1 - i);
+
+		for (size_t i = reversed; i < entries.size(); i += size_t(1) << len)
+			entries[i] = uint16_t((sym << 4) | len);
+	}
+}
+
+int Inflate::nextByte()
+{
+	if(m_in == m_inEnd)
+	{
+		if (!m_src) return -1;
+		m_src->read(reinterpret_cast<char*>(m_buffer.data()), std::streamsize(m_buffer.size()));
+		const auto count = size_t(m_src->gcount());
+		if (count == 0) return -1;
+		m_in = m_buffer.data();
+		m_inEnd = m_in + count;
+	}
+	return *m_in++;
+}
+
+void Inflate::refillBits()
+{
+	while(m_numBits <= 56)
+	{
+		int byte = nextByte();
+		if (byte < 0)
+		{
+			// end of the input => zeros (checked in decodeBlock())
+			++m_padded;
+			byte = 0;
+		}
+		m_bits |= uint64_t(byte) << m_numBits;
+		m_numBits += 8;
+	}
+}
+
+uint32_t Inflate::getBits(int count)
+{
+	if (count == 0) return 0;
+	if (m_numBits < count) refillBits();
+	const auto res = uint32_t(m_bits & ((uint64_t(1) << count) - 1));
+	m_bits >>= count;
+	m_numBits -= count;
+	return res;
+}
+
+uint32_t Inflate::decodeSymbol(const Table& table)
+{
+	if (m_numBits < table.maxBits) refillBits();
+	const auto entry = table.entries.empty() ? 0 : table.entries[size_t(m_bits & ((uint64_t(1) << table.maxBits) - 1))];
+	const int len = entry & 15;
+	if (len == 0)
+		throw std::runtime_error("deflate: invalid huffman code");
+	m_bits >>= len;
+	m_numBits -= len;
+	return entry >> 4;
+}
+
+bool Inflate::decodeBlock()
+{
+	if (m_final) return false;
+
+	m_final = getBits(1) != 0;
+	switch(getBits(2))
+	{
+	case 0:
+		decodeStored();
+		break;
+	case 1:
+	{
+		static const auto fixed = []()
+		{
+			std::pair<Table, Table> res;
+			uint8_t lengths[288];
+			std::fill(lengths, lengths + 144, uint8_t(8));
+			std::fill(lengths + 144, lengths + 256, uint8_t(9));
+			std::fill(lengths + 256, lengths + 280, uint8_t(7));
+			std::fill(lengths + 280, lengths + 288, uint8_t(8));
+			res.first.build(lengths, 288);
+			std::fill(lengths, lengths + 30, uint8_t(5));
+			res.second.build(lengths, 30);
+			return res;
+		}();
+		decodeCompressed(fixed.first, fixed.second);
+		break;
+	}
+	case 2:
+		decodeDynamicTables();
+		decodeCompressed(m_litLen, m_dist);
+		break;
+	default:
+		throw std::runtime_error("deflate: invalid block type");
+	}
+
+	// the padding at the end of the input must not be consumed
+	if (m_padded * 8 > m_numBits)
+		throw std::runtime_error("deflate: unexpected end of data");
+	return true;
+}
+
+void Inflate::reset()
+{
+	m_final = false;
+	m_output.clear();
+}
+
+void Inflate::decodeStored()
+{
+	uint8_t header[4];
+	if (readBytes(header, 4) != 4)
+		throw std::runtime_error("deflate: unexpected end of data");
+	const size_t len = header[0] | (header[1] << 8);
+	const size_t nlen = header[2] | (header[3] << 8);
+	if (len != (~nlen & 0xFFFF))
+		throw std::runtime_error("deflate: invalid stored block length");
+
+	const auto offset = m_output.size();
+	m_output.resize(offset + len);
+	if (readBytes(m_output.data() + offset, len) != len)
+		throw std::runtime_error("deflate: unexpected end of data");
+}
+
+void Inflate::decodeDynamicTables()
+{
+	const auto numLitLen = getBits(5) + 257;
+	const auto numDist = getBits(5) + 1;
+	const auto numCodeLengths = getBits(4) + 4;
+
+	uint8_t codeLengths[19] = {};
+	for (uint32_t i = 0; i < numCodeLengths; ++i)
+		codeLengths[s_codeLengthOrder[i]] = uint8_t(getBits(3));
+	Table codeLengthTable;
+	codeLengthTable.build(codeLengths, 19);
+
+	uint8_t lengths[288 + 32] = {};
+	for(uint32_t n = 0; n < numLitLen + numDist;)
+	{
+		const auto sym = decodeSymbol(codeLengthTable);
+		if(sym < 16)
+		{
+			lengths[n++] = uint8_t(sym);
+			continue;
+		}
+
+		uint8_t value = 0;
+		uint32_t repeat;
+		if(sym == 16)
+		{
+			if (n == 0)
+				throw std::runtime_error("deflate: repeat without previous length");
+			value = lengths[n - 1];
+			repeat = 3 + getBits(2);
+		}
+		else if (sym == 17) repeat = 3 + getBits(3);
+		else repeat = 11 + getBits(7);
+
+		if (n + repeat > numLitLen + numDist)
+			throw std::runtime_error("deflate: too many code lengths");
+		std::fill(lengths + n, lengths + n + repeat, value);
+		n += repeat;
+	}
+
+	m_litLen.build(lengths, numLitLen);
+	m_dist.build(lengths + numLitLen, numDist);
+}
+
+void Inflate::decodeCompressed(const Table& litLen, const Table& dist)
+{
+	while(true)
+	{
+		const auto sym = decodeSymbol(litLen);
+		// decoding the padding would never end
+		if (m_padded * 8 > m_numBits)
+			throw std::runtime_error("deflate: unexpected end of data");
+		if(sym < 256)
+		{
+			m_output.push_back(uint8_t(sym));
+			continue;
+		}
+		if (sym == 256) return; // end of block
+
+		const auto lengthCode = sym - 257;
+		if (lengthCode >= std::size(s_lengthBase))
+			throw std::runtime_error("deflate: invalid length code");
+		const size_t length = s_lengthBase[lengthCode] + getBits(s_lengthExtra[lengthCode]);
+
+		const auto distCode = decodeSymbol(dist);
+		if (distCode >= std::size(s_distBase))
+			throw std::runtime_error("deflate: invalid distance code");
+		const size_t distance = s_distBase[distCode] + getBits(s_distExtra[distCode]);
+		if (distance > m_output.size())
+			throw std::runtime_error("deflate: distance too far back");
+
+		// the source may overlap with the copied bytes
+		const auto offset = m_output.size();
+		m_output.resize(offset + length);
+		uint8_t* dst = m_output.data() + offset;
+		const uint8_t* src = dst - distance;
+		for (size_t i = 0; i < length; ++i)
+			dst[i] = src[i];
+	}
+}
+
+size_t Inflate::discardOutput()
+{
+	if(m_output.size() > s_windowSize)
+		m_output.erase(m_output.begin(), m_output.end() - s_windowSize);
+	return m_output.size();
+}
+
+size_t Inflate::readBytes(void* dst, size_t size)
+{
+	auto out = static_cast<uint8_t*>(dst);
+
+	// skip the bits of the partially consumed byte
+	const int partial = m_numBits % 8;
+	m_bits >>= partial;
+	m_numBits -= partial;
+
+	size_t count = 0;
+	while(count < size && m_numBits / 8 > m_padded)
+	{
+		out[count++] = uint8_t(m_bits);
+		m_bits >>= 8;
+		m_numBits -= 8;
+	}
+	if (count == size) return count;
+
+	// bit buffer contains only padding
+	m_bits = 0;
+	m_numBits = 0;
+	m_padded = 0;
+
+	while(count < size)
+	{
+		if(m_in == m_inEnd)
+		{
+			const int byte = nextByte();
+			if (byte < 0) break;
+			out[count++] = uint8_t(byte);
+			continue;
+		}
+		const auto n = std::min(size - count, size_t(m_inEnd - m_in));
+		memcpy(out + count, m_in, n);
+		m_in += n;
+		count += n;
+	}
+	return count;
+}
+
+bool Inflate::atEnd()
+{
+	if (m_numBits / 8 > m_padded) return false;
+	if (m_in != m_inEnd) return false;
+	const int byte = nextByte();
+	if (byte < 0) return true;
+	--m_in; // the byte is still in the buffer
+	return false;
+}
+
+std::vector<uint8_t> Inflate::decompress(const uint8_t* data, size_t size, size_t sizeHint)
+{
+	Inflate inflate(data, size);
+	inflate.m_output.reserve(sizeHint);
+	while (inflate.decodeBlock()) {}
+	return std::move(inflate.m_output);
+}
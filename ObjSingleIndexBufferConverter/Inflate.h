@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <istream>
+#include <cstdint>
+#include <cstddef>
+
+// raw deflate (RFC 1951) decoder that works block by block.
+// The output of all blocks is appended to an internal buffer that keeps the 32 KB window for back references
+class Inflate
+{
+public:
+	/// \brief decoder that reads the compressed data from a stream
+	explicit Inflate(std::istream& src);
+	/// \brief decoder for compressed data in memory
+	Inflate(const uint8_t* data, size_t size);
+
+	/// \brief decodes the next block and appends its output to getOutput(). throws if the data is invalid
+	/// \return false if the final block of the deflate stream was already decoded
+	bool decodeBlock();
+	/// \brief prepares for the next deflate stream (after the final block)
+	void reset();
+
+	const std::vector<uint8_t>& getOutput() const { return m_output; }
+	/// \brief removes the output except for the window that is required by back references
+	/// \return number of remaining bytes
+	size_t discardOutput();
+
+	/// \brief reads bytes after the deflate stream (byte aligned, e.g. gzip trailer and headers)
+	/// \return number of bytes read (less than size at the end of the input)
+	size_t readBytes(void* dst, size_t size);
+	/// \brief indicates if all input was consumed
+	bool atEnd();
+
+	/// \brief decodes a complete deflate stream from memory
+	/// \param sizeHint expected output size
+	static std::vector<uint8_t> decompress(const uint8_t* data, size_t size, size_t sizeHint = 0);
+private:
+	// canonical huffman code lookup (indexed by the bit reversed code)
+	struct Table
+	{
+		// (symbol << 4) | code length
+		std::vector<uint16_t> entries;
+		int maxBits = 0;
+
+		void build(const uint8_t* lengths, size_t count);
+	};
+
+	int nextByte();
+	void refillBits();
+	uint32_t getBits(int count);
+	uint32_t decodeSymbol(const Table& table);
+	void decodeStored();
+	void decodeDynamicTables();
+	void decodeCompressed(const Table& litLen, const Table& dist);
+
+	std::istream* m_src = nullptr;
+	std::vector<uint8_t> m_buffer;
+	const uint8_t* m_in = nullptr;
+	const uint8_t* m_inEnd = nullptr;
+
+	uint64_t m_bits = 0;
+	int m_numBits = 0;
+	// zero bytes that were added to the bit buffer after the end of the input
+	int m_padded = 0;
+	bool m_final = false;
+
+	Table m_litLen;
+	Table m_dist;
+	std::vector<uint8_t> m_output;
+};
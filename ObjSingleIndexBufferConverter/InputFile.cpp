@@ -0,0 +1,51 @@
+#include "InputFile.h"
+#include <stdexcept>
+
+static bool isZstd(const uint8_t* data, size_t size)
+{
+	return size >= 4 && data[0] == 0x28 && data[1] == 0xB5 && data[2] == 0x2F && data[3] == 0xFD;
+}
+
+// reads the first bytes and rewinds the file
+static size_t readMagic(std::ifstream& file, uint8_t* dst, size_t size)
+{
+	file.read(reinterpret_cast<char*>(dst), std::streamsize(size));
+	const auto count = size_t(file.gcount());
+	file.clear();
+	file.seekg(0);
+	return count;
+}
+
+InputFile::InputFile(const std::filesystem::path& filename)
+	:
+m_file(filename, std::ios::binary),
+m_stream(nullptr)
+{
+	if (!m_file.is_open())
+		throw std::runtime_error("could not open " + filename.string());
+	m_size = std::filesystem::file_size(filename);
+
+	uint8_t magic[4];
+	const auto count = readMagic(m_file, magic, sizeof(magic));
+	if (isZstd(magic, count))
+		throw std::runtime_error("zstd compressed obj files are not supported, recompress " + filename.string() + " with gzip (bgzip for parallel decompression)");
+
+	if(GzipStream::hasMagic(magic, count))
+	{
+		m_gzip = std::make_unique<GzipStream>(m_file);
+		m_stream.rdbuf(m_gzip.get());
+		// decoding errors are rethrown instead of ending the stream silently
+		m_stream.exceptions(std::ios::badbit);
+	}
+	else
+	{
+		// text mode line endings are handled by the obj parser
+		m_stream.rdbuf(m_file.rdbuf());
+	}
+}
+
+uint64_t InputFile::getPosition()
+{
+	const auto pos = m_file.tellg();
+	return pos > 0 ? uint64_t(pos) : 0;
+}
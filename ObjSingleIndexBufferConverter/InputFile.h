@@ -0,0 +1,29 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <cstdint>
+#include "GzipStream.h"
+
+// opens an obj file that may be gzip compressed (.obj.gz, detected by the magic bytes).
+// getStream() returns the decompressed text
+class InputFile
+{
+public:
+	/// \brief opens the file. throws if it cannot be opened or uses an unsupported compression
+	explicit InputFile(const std::filesystem::path& filename);
+	InputFile(const InputFile&) = delete;
+	InputFile& operator=(const InputFile&) = delete;
+
+	std::istream& getStream() { return m_stream; }
+	bool isCompressed() const { return m_gzip != nullptr; }
+	/// \brief position in the (compressed) file, used for progress reports
+	uint64_t getPosition();
+	/// \brief size of the (compressed) file
+	uint64_t getSize() const { return m_size; }
+private:
+	std::ifstream m_file;
+	std::unique_ptr<GzipStream> m_gzip;
+	std::istream m_stream;
+	uint64_t m_size = 0;
+};
@@ -0,0 +1,273 @@
+#include "Ktx2Writer.h"
+#include "Deflate.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const uint8_t s_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	// khronos data format color models
+	enum ColorModel : uint8_t
+	{
+		RGBSDA = 1,
+		BC1A = 128,
+		BC3 = 130,
+		BC5 = 132,
+		BC7 = 134
+	};
+
+	// sample channel ids
+	constexpr uint8_t s_channelRed = 0;
+	constexpr uint8_t s_channelGreen = 1;
+	constexpr uint8_t s_channelBlue = 2;
+	constexpr uint8_t s_channelAlpha = 15;
+	constexpr uint8_t s_qualifierLinear = 0x10;
+
+	template<class T>
+	void append(std::vector<uint8_t>& dst, T value)
+	{
+		const auto ptr = reinterpret_cast<const uint8_t*>(&value);
+		dst.insert(dst.end(), ptr, ptr + sizeof(T));
+	}
+
+	size_t alignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	bool isSrgb(DdsWriter::DxgiFormat format)
+	{
+		return format == DdsWriter::R8G8B8A8_UNORM_SRGB || format == DdsWriter::BC1_UNORM_SRGB ||
+			format == DdsWriter::BC3_UNORM_SRGB || format == DdsWriter::BC7_UNORM_SRGB;
+	}
+}
+
+Ktx2Writer::Ktx2Writer(const std::filesystem::path& filename, DdsWriter::DxgiFormat format, int width, int height, int numMipmaps, Supercompression supercompression)
+	:
+m_file(filename, std::ios::binary),
+m_format(format),
+m_width(width),
+m_height(height),
+m_supercompression(supercompression),
+m_levels(numMipmaps)
+{
+	if (!m_file.is_open())
+		throw std::runtime_error("could not open " + filename.string() + " for writing");
+
+	for(int i = 0; i < numMipmaps; ++i)
+	{
+		m_levels[i].uncompressedSize = DdsWriter::getMipmapSize(format, std::max(width >> i, 1), std::max(height >> i, 1));
+		m_levels[i].size = m_levels[i].uncompressedSize;
+	}
+
+	if (m_supercompression != None) return;
+
+	// the sizes are known => place the levels (smallest first) after the header
+	const size_t alignment = DdsWriter::isBlockCompressed(format) ? (format <= DdsWriter::BC1_UNORM_SRGB ? 8 : 16) : 4;
+	size_t offset = getHeaderSize();
+	for(auto level = m_levels.rbegin(); level != m_levels.rend(); ++level)
+	{
+		offset = alignUp(offset, alignment);
+		level->offset = offset;
+		offset += level->size;
+	}
+}
+
+void Ktx2Writer::writeMipmap(const uint8_t* data, size_t size)
+{
+	if (m_curLevel >= m_levels.size())
+		throw std::runtime_error("ktx2: too many mipmaps");
+	auto& level = m_levels[m_curLevel++];
+	if (size != level.uncompressedSize)
+		throw std::runtime_error("ktx2: unexpected mipmap size");
+
+	if(m_supercompression == Zlib)
+	{
+		level.data = Deflate::compress(data, size);
+		level.size = level.data.size();
+		return;
+	}
+
+	m_file.seekp(std::streamoff(level.offset));
+	m_file.write(reinterpret_cast<const char*>(data), std::streamsize(size));
+	if (!m_file)
+		throw std::runtime_error("could not write ktx2 mipmap");
+}
+
+void Ktx2Writer::finish()
+{
+	if (m_curLevel != m_levels.size())
+		throw std::runtime_error("ktx2: missing mipmaps");
+
+	const auto dfd = getDataFormatDescriptor();
+	const auto kvd = getKeyValueData();
+	const size_t dfdOffset = getIndexEnd();
+	const size_t kvdOffset = dfdOffset + dfd.size();
+
+	if(m_supercompression != None)
+	{
+		// no alignment required for supercompressed data
+		size_t offset = getHeaderSize();
+		for(auto level = m_levels.rbegin(); level != m_levels.rend(); ++level)
+		{
+			level->offset = offset;
+			offset += level->size;
+		}
+	}
+
+	std::vector<uint8_t> header(s_identifier, s_identifier + sizeof(s_identifier));
+	append<uint32_t>(header, getVkFormat(m_format));
+	append<uint32_t>(header, 1); // type size
+	append<uint32_t>(header, uint32_t(m_width));
+	append<uint32_t>(header, uint32_t(m_height));
+	append<uint32_t>(header, 0); // depth
+	append<uint32_t>(header, 0); // layers
+	append<uint32_t>(header, 1); // faces
+	append<uint32_t>(header, uint32_t(m_levels.size()));
+	append<uint32_t>(header, m_supercompression);
+	// index
+	append<uint32_t>(header, uint32_t(dfdOffset));
+	append<uint32_t>(header, uint32_t(dfd.size()));
+	append<uint32_t>(header, uint32_t(kvdOffset));
+	append<uint32_t>(header, uint32_t(kvd.size()));
+	append<uint64_t>(header, 0); // supercompression global data
+	append<uint64_t>(header, 0);
+	for(const auto& level : m_levels)
+	{
+		append<uint64_t>(header, level.offset);
+		append<uint64_t>(header, level.size);
+		append<uint64_t>(header, level.uncompressedSize);
+	}
+	header.insert(header.end(), dfd.begin(), dfd.end());
+	header.insert(header.end(), kvd.begin(), kvd.end());
+
+	m_file.seekp(0);
+	m_file.write(reinterpret_cast<const char*>(header.data()), std::streamsize(header.size()));
+
+	if(m_supercompression != None)
+	{
+		for(auto level = m_levels.rbegin(); level != m_levels.rend(); ++level)
+		{
+			m_file.write(reinterpret_cast<const char*>(level->data.data()), std::streamsize(level->data.size()));
+			level->data = std::vector<uint8_t>();
+		}
+	}
+
+	m_file.flush();
+	if (!m_file)
+		throw std::runtime_error("could not write ktx2 file");
+}
+
+uint32_t Ktx2Writer::getVkFormat(DdsWriter::DxgiFormat format)
+{
+	switch (format)
+	{
+	case DdsWriter::R8G8B8A8_UNORM: return 37;
+	case DdsWriter::R8G8B8A8_UNORM_SRGB: return 43;
+	case DdsWriter::BC1_UNORM: return 133;
+	case DdsWriter::BC1_UNORM_SRGB: return 134;
+	case DdsWriter::BC3_UNORM: return 137;
+	case DdsWriter::BC3_UNORM_SRGB: return 138;
+	case DdsWriter::BC5_UNORM: return 141;
+	case DdsWriter::BC7_UNORM: return 145;
+	case DdsWriter::BC7_UNORM_SRGB: return 146;
+	}
+	throw std::runtime_error("ktx2: unsupported format");
+}
+
+std::vector<uint8_t> Ktx2Writer::getDataFormatDescriptor() const
+{
+	struct Sample
+	{
+		uint16_t bitOffset;
+		uint8_t bitLength;
+		uint8_t channel;
+		uint32_t upper;
+	};
+	std::vector<Sample> samples;
+	ColorModel model = RGBSDA;
+	uint8_t blockDim = 0;
+	uint8_t bytesPlane = 4;
+	switch (m_format)
+	{
+	case DdsWriter::R8G8B8A8_UNORM:
+	case DdsWriter::R8G8B8A8_UNORM_SRGB:
+		// alpha is always linear
+		samples = { { 0, 7, s_channelRed, 255 }, { 8, 7, s_channelGreen, 255 }, { 16, 7, s_channelBlue, 255 }, { 24, 7, s_channelAlpha | s_qualifierLinear, 255 } };
+		break;
+	case DdsWriter::BC1_UNORM:
+	case DdsWriter::BC1_UNORM_SRGB:
+		model = BC1A;
+		samples = { { 0, 63, s_channelRed, 0xFFFFFFFF } };
+		blockDim = 3;
+		bytesPlane = 8;
+		break;
+	case DdsWriter::BC3_UNORM:
+	case DdsWriter::BC3_UNORM_SRGB:
+		model = BC3;
+		samples = { { 0, 63, s_channelAlpha | s_qualifierLinear, 0xFFFFFFFF }, { 64, 63, s_channelRed, 0xFFFFFFFF } };
+		blockDim = 3;
+		bytesPlane = 16;
+		break;
+	case DdsWriter::BC5_UNORM:
+		model = BC5;
+		samples = { { 0, 63, s_channelRed, 0xFFFFFFFF }, { 64, 63, s_channelGreen, 0xFFFFFFFF } };
+		blockDim = 3;
+		bytesPlane = 16;
+		break;
+	case DdsWriter::BC7_UNORM:
+	case DdsWriter::BC7_UNORM_SRGB:
+		model = BC7;
+		samples = { { 0, 127, s_channelRed, 0xFFFFFFFF } };
+		blockDim = 3;
+		bytesPlane = 16;
+		break;
+	}
+	// the plane size is unknown for supercompressed data
+	if (m_supercompression != None)
+		bytesPlane = 0;
+
+	const uint32_t blockSize = 24 + 16 * uint32_t(samples.size());
+	std::vector<uint8_t> res;
+	append<uint32_t>(res, 4 + blockSize); // total size
+	append<uint32_t>(res, 0); // vendor id khronos, descriptor type basic
+	append<uint32_t>(res, 2 | (blockSize << 16)); // version 1.3
+	const uint8_t transfer = isSrgb(m_format) ? 2 : 1;
+	append<uint32_t>(res, uint32_t(model) | (1u << 8) | (uint32_t(transfer) << 16)); // primaries bt709, straight alpha
+	append<uint32_t>(res, uint32_t(blockDim) | (uint32_t(blockDim) << 8));
+	append<uint32_t>(res, bytesPlane);
+	append<uint32_t>(res, 0);
+	for(const auto& s : samples)
+	{
+		append<uint32_t>(res, uint32_t(s.bitOffset) | (uint32_t(s.bitLength) << 16) | (uint32_t(s.channel) << 24));
+		append<uint32_t>(res, 0); // sample position
+		append<uint32_t>(res, 0); // lower
+		append<uint32_t>(res, s.upper);
+	}
+	return res;
+}
+
+std::vector<uint8_t> Ktx2Writer::getKeyValueData()
+{
+	static const char key[] = "KTXwriter";
+	static const char value[] = "ObjToHrsfConverter";
+	std::vector<uint8_t> res;
+	append<uint32_t>(res, uint32_t(sizeof(key) + sizeof(value)));
+	res.insert(res.end(), key, key + sizeof(key));
+	res.insert(res.end(), value, value + sizeof(value));
+	res.resize(alignUp(res.size(), 4));
+	return res;
+}
+
+size_t Ktx2Writer::getIndexEnd() const
+{
+	// identifier, header, index, level index
+	return sizeof(s_identifier) + 9 * 4 + 4 * 4 + 2 * 8 + m_levels.size() * 3 * 8;
+}
+
+size_t Ktx2Writer::getHeaderSize() const
+{
+	return getIndexEnd() + getDataFormatDescriptor().size() + getKeyValueData().size();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include "DdsWriter.h"
+#include "TextureWriter.h"
+
+// writes a 2D texture with mipmaps into a ktx2 file.
+// Mipmaps are stored smallest first, as required by the format. Without supercompression every mipmap
+// is written directly to its final position. Supercompressed mipmaps are kept until finish()
+class Ktx2Writer : public TextureWriter
+{
+public:
+	enum Supercompression : uint32_t
+	{
+		None = 0,
+		Zlib = 3
+	};
+
+	/// \brief creates the file
+	/// \param numMipmaps number of mipmaps that will be written with writeMipmap()
+	Ktx2Writer(const std::filesystem::path& filename, DdsWriter::DxgiFormat format, int width, int height, int numMipmaps, Supercompression supercompression);
+
+	/// \brief writes the next mipmap (largest mipmap first)
+	void writeMipmap(const uint8_t* data, size_t size) override;
+	/// \brief writes the header and the supercompressed mipmaps
+	void finish() override;
+
+	static uint32_t getVkFormat(DdsWriter::DxgiFormat format);
+private:
+	struct Level
+	{
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint64_t uncompressedSize = 0;
+		// supercompressed data
+		std::vector<uint8_t> data;
+	};
+
+	std::vector<uint8_t> getDataFormatDescriptor() const;
+	static std::vector<uint8_t> getKeyValueData();
+	/// offset of the data format descriptor (end of the level index)
+	size_t getIndexEnd() const;
+	/// size of everything in front of the mipmap data
+	size_t getHeaderSize() const;
+
+	std::ofstream m_file;
+	DdsWriter::DxgiFormat m_format;
+	int m_width;
+	int m_height;
+	Supercompression m_supercompression;
+	std::vector<Level> m_levels;
+	size_t m_curLevel = 0;
+};
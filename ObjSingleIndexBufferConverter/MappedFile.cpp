@@ -0,0 +1,71 @@
+#include "MappedFile.h"
+#include <stdexcept>
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+MappedFile::MappedFile(const std::filesystem::path& filename, size_t size)
+	:
+m_size(size)
+{
+	m_file = CreateFileW(filename.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		m_file = nullptr;
+		throw std::runtime_error("could not open " + filename.string() + " for writing");
+	}
+
+	// the mapping extends the file to the requested size
+	const auto size64 = uint64_t(size);
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE, DWORD(size64 >> 32), DWORD(size64 & 0xFFFFFFFF), nullptr);
+	if(!m_mapping)
+	{
+		CloseHandle(m_file);
+		throw std::runtime_error("could not create file mapping for " + filename.string());
+	}
+
+	m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, size));
+	if(!m_data)
+	{
+		CloseHandle(m_mapping);
+		CloseHandle(m_file);
+		throw std::runtime_error("could not map " + filename.string());
+	}
+}
+
+MappedFile::MappedFile(const std::filesystem::path& filename)
+	:
+m_size(size_t(std::filesystem::file_size(filename)))
+{
+	if (m_size == 0)
+		throw std::runtime_error("could not map empty file " + filename.string());
+
+	m_file = CreateFileW(filename.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		m_file = nullptr;
+		throw std::runtime_error("could not open " + filename.string() + " for reading");
+	}
+
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping)
+	{
+		CloseHandle(m_file);
+		throw std::runtime_error("could not create file mapping for " + filename.string());
+	}
+
+	m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data)
+	{
+		CloseHandle(m_mapping);
+		CloseHandle(m_file);
+		throw std::runtime_error("could not map " + filename.string());
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_mapping) CloseHandle(m_mapping);
+	if (m_file) CloseHandle(m_file);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <filesystem>
+#include <cstdint>
+
+// file that is mapped into memory. Either created with a fixed size for writing or an existing file for reading.
+// Written pages are paged out by the os, so the file size is not bound by the available memory
+class MappedFile
+{
+public:
+	/// \brief creates (or truncates) the file with the given size and maps it
+	MappedFile(const std::filesystem::path& filename, size_t size);
+	/// \brief maps an existing file read-only. throws if the file does not exist or is empty
+	explicit MappedFile(const std::filesystem::path& filename);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	uint8_t* getData() { return m_data; }
+	const uint8_t* getData() const { return m_data; }
+	size_t getSize() const { return m_size; }
+private:
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+	uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+};
@@ -0,0 +1,72 @@
+#include "MeshSpill.h"
+#include <stdexcept>
+
+MeshSpill::MeshSpill(std::filesystem::path filename)
+	:
+m_filename(std::move(filename))
+{
+	m_file.open(m_filename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_file.is_open())
+		throw std::runtime_error("could not create temporary mesh file " + m_filename.string());
+}
+
+MeshSpill::~MeshSpill()
+{
+	m_file.close();
+	std::error_code ec;
+	std::filesystem::remove(m_filename, ec);
+}
+
+void MeshSpill::add(const bmf::BinaryMesh16& mesh)
+{
+	const auto& vertices = mesh.getVertices();
+	const auto& indices = mesh.getIndices();
+	const auto& shapes = mesh.getShapes();
+
+	Entry e;
+	e.offset = m_offset;
+	e.attributes = mesh.getAttributes();
+	e.materialId = shapes.empty() ? uint32_t(-1) : shapes[0].materialId;
+	e.numVertexFloats = uint32_t(vertices.size());
+	e.numIndices = uint32_t(indices.size());
+	e.numShapes = uint32_t(shapes.size());
+
+	m_file.seekp(std::streamoff(m_offset));
+	m_file.write(reinterpret_cast<const char*>(vertices.data()), std::streamsize(vertices.size() * sizeof(vertices[0])));
+	m_file.write(reinterpret_cast<const char*>(indices.data()), std::streamsize(indices.size() * sizeof(indices[0])));
+	m_file.write(reinterpret_cast<const char*>(shapes.data()), std::streamsize(shapes.size() * sizeof(shapes[0])));
+	if (!m_file)
+		throw std::runtime_error("could not write temporary mesh file " + m_filename.string());
+
+	m_entries.push_back(e);
+	const auto bytes = getBytes(m_entries.size() - 1);
+	m_offset += bytes;
+	m_totalBytes += bytes;
+}
+
+bmf::BinaryMesh16 MeshSpill::get(size_t index, uint32_t defaultMaterial)
+{
+	const auto& e = m_entries.at(index);
+	std::vector<float> vertices(e.numVertexFloats);
+	std::vector<uint16_t> indices(e.numIndices);
+	std::vector<bmf::Shape> shapes(e.numShapes);
+
+	m_file.seekg(std::streamoff(e.offset));
+	m_file.read(reinterpret_cast<char*>(vertices.data()), std::streamsize(vertices.size() * sizeof(vertices[0])));
+	m_file.read(reinterpret_cast<char*>(indices.data()), std::streamsize(indices.size() * sizeof(indices[0])));
+	m_file.read(reinterpret_cast<char*>(shapes.data()), std::streamsize(shapes.size() * sizeof(shapes[0])));
+	if (!m_file)
+		throw std::runtime_error("could not read temporary mesh file " + m_filename.string());
+
+	// the number of materials was not known when the mesh was converted
+	for (auto& s : shapes)
+		if (s.materialId == uint32_t(-1)) s.materialId = defaultMaterial;
+
+	return bmf::BinaryMesh16(e.attributes, std::move(vertices), std::move(indices), std::move(shapes));
+}
+
+uint64_t MeshSpill::getBytes(size_t index) const
+{
+	const auto& e = m_entries[index];
+	return uint64_t(e.numVertexFloats) * sizeof(float) + uint64_t(e.numIndices) * sizeof(uint16_t) + uint64_t(e.numShapes) * sizeof(bmf::Shape);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <hrsf/SceneFormat.h>
+
+// temporary file for converted meshes (streaming conversion).
+// Meshes are appended as soon as they are converted and read back when the final meshes are merged.
+// Only the offsets and material ids stay in memory
+class MeshSpill
+{
+public:
+	/// \brief creates the temporary file. throws on errors
+	explicit MeshSpill(std::filesystem::path filename);
+	/// \brief deletes the temporary file
+	~MeshSpill();
+	MeshSpill(const MeshSpill&) = delete;
+	MeshSpill& operator=(const MeshSpill&) = delete;
+
+	/// \brief appends the mesh to the file
+	void add(const bmf::BinaryMesh16& mesh);
+	/// \brief reads a mesh back from the file
+	/// \param defaultMaterial replaces the material id uint32_t(-1) of the shapes
+	bmf::BinaryMesh16 get(size_t index, uint32_t defaultMaterial);
+
+	size_t size() const { return m_entries.size(); }
+	/// material id of the first shape
+	uint32_t getMaterialId(size_t index) const { return m_entries[index].materialId; }
+	/// size of the mesh in memory
+	uint64_t getBytes(size_t index) const;
+	/// size of all meshes in memory
+	uint64_t getTotalBytes() const { return m_totalBytes; }
+private:
+	struct Entry
+	{
+		uint64_t offset;
+		uint32_t attributes;
+		uint32_t materialId;
+		uint32_t numVertexFloats;
+		uint32_t numIndices;
+		uint32_t numShapes;
+	};
+
+	std::filesystem::path m_filename;
+	std::fstream m_file;
+	std::vector<Entry> m_entries;
+	uint64_t m_offset = 0;
+	uint64_t m_totalBytes = 0;
+};
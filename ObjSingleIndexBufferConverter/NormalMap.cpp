@@ -0,0 +1,119 @@
+#include "NormalMap.h"
+#include <algorithm>
+#include <numeric>
+#include <execution>
+#include <cmath>
+
+// height difference of 1.0 (full range) between neighboring texels => slope of s_heightScale
+static constexpr float s_heightScale = 32.0f;
+
+static float decode(uint8_t v)
+{
+	return float(v) / 255.0f * 2.0f - 1.0f;
+}
+
+static uint8_t encode(float v)
+{
+	return uint8_t(std::clamp(v * 0.5f + 0.5f, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static void writeNormal(uint8_t* dst, float x, float y, float z)
+{
+	const float len = std::sqrt(x * x + y * y + z * z);
+	if(len < 1e-6f)
+	{
+		x = 0.0f;
+		y = 0.0f;
+		z = 1.0f;
+	}
+	else
+	{
+		x /= len;
+		y /= len;
+		z /= len;
+	}
+	dst[0] = encode(x);
+	dst[1] = encode(y);
+	dst[2] = encode(z);
+	dst[3] = 255;
+}
+
+Image NormalMap::fromHeight(const Image& height, float strength)
+{
+	const int width = height.getWidth();
+	const int rows = height.getHeight();
+
+	// heights as float rows with one replicated border texel on each side
+	const int stride = width + 2;
+	std::vector<float> heights(size_t(stride) * size_t(rows));
+	std::vector<int> rowIndices(rows);
+	std::iota(rowIndices.begin(), rowIndices.end(), 0);
+	std::for_each(std::execution::par, rowIndices.begin(), rowIndices.end(), [&](int y)
+	{
+		float* dst = &heights[size_t(y) * stride];
+		const uint8_t* src = height.getPixel(0, y);
+		for (int x = 0; x < width; ++x)
+			dst[x + 1] = float(src[x * 4] + src[x * 4 + 1] + src[x * 4 + 2]) / (3.0f * 255.0f);
+		dst[0] = dst[1];
+		dst[width + 1] = dst[width];
+	});
+
+	// normalized sobel gradient (divided by 8) scaled by the strength
+	const float scale = strength * s_heightScale / 8.0f;
+	Image res(width, rows);
+	std::for_each(std::execution::par, rowIndices.begin(), rowIndices.end(), [&](int y)
+	{
+		const float* top = &heights[size_t(std::max(y - 1, 0)) * stride + 1];
+		const float* mid = &heights[size_t(y) * stride + 1];
+		const float* bot = &heights[size_t(std::min(y + 1, rows - 1)) * stride + 1];
+
+		// branch free inner loops over contiguous rows => auto vectorized
+		std::vector<float> gx(width), gy(width);
+		for(int x = 0; x < width; ++x)
+		{
+			gx[x] = (top[x + 1] + 2.0f * mid[x + 1] + bot[x + 1]) - (top[x - 1] + 2.0f * mid[x - 1] + bot[x - 1]);
+			gy[x] = (bot[x - 1] + 2.0f * bot[x] + bot[x + 1]) - (top[x - 1] + 2.0f * top[x] + top[x + 1]);
+		}
+
+		uint8_t* dst = res.getPixel(0, y);
+		for (int x = 0; x < width; ++x)
+			writeNormal(dst + x * 4, -gx[x] * scale, -gy[x] * scale, 1.0f);
+	});
+
+	return res;
+}
+
+void NormalMap::normalize(Image& image)
+{
+	std::vector<int> rows(image.getHeight());
+	std::iota(rows.begin(), rows.end(), 0);
+	std::for_each(std::execution::par, rows.begin(), rows.end(), [&image](int y)
+	{
+		uint8_t* p = image.getPixel(0, y);
+		for (int x = 0; x < image.getWidth(); ++x, p += 4)
+			writeNormal(p, decode(p[0]), decode(p[1]), decode(p[2]));
+	});
+}
+
+Image NormalMap::generateMipmap(const Image& image)
+{
+	Image res(std::max(image.getWidth() / 2, 1), std::max(image.getHeight() / 2, 1));
+	for(int y = 0; y < res.getHeight(); ++y)
+	{
+		const int y0 = std::min(y * 2, image.getHeight() - 1);
+		const int y1 = std::min(y * 2 + 1, image.getHeight() - 1);
+		for(int x = 0; x < res.getWidth(); ++x)
+		{
+			const int x0 = std::min(x * 2, image.getWidth() - 1);
+			const int x1 = std::min(x * 2 + 1, image.getWidth() - 1);
+			const uint8_t* src[] = { image.getPixel(x0, y0), image.getPixel(x1, y0), image.getPixel(x0, y1), image.getPixel(x1, y1) };
+
+			float n[3] = { 0.0f, 0.0f, 0.0f };
+			for (auto s : src)
+				for (int c = 0; c < 3; ++c)
+					n[c] += decode(s[c]);
+			writeNormal(res.getPixel(x, y), n[0], n[1], n[2]);
+		}
+	}
+	return res;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "Image.h"
+
+// tangent space normal map operations (directX convention: green points down in image space).
+// Normals are stored as rgb = n * 0.5 + 0.5
+class NormalMap
+{
+public:
+	/// \brief converts a height map (average of rgb) into a normal map with a sobel kernel.
+	/// Rows are processed in parallel
+	/// \param strength scales the height differences (bump multiplier of the material)
+	static Image fromHeight(const Image& height, float strength);
+
+	/// \brief normalizes all normals of the image (e.g. after quantization or resampling)
+	static void normalize(Image& image);
+
+	/// \brief generates the next smaller mipmap by averaging and renormalizing the normals
+	static Image generateMipmap(const Image& image);
+};
@@ -0,0 +1,352 @@
+#include "ObjCache.h"
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+#include <map>
+#include "MappedFile.h"
+#include "XXHash64.h"
+#include "Console.h"
+#include "Profiler.h"
+
+static constexpr char s_magic[4] = { 'O', 'B', 'J', 'C' };
+static constexpr uint32_t s_version = 1;
+
+namespace
+{
+	// writes into the mapped file or only counts the bytes if there is no destination
+	class Writer
+	{
+	public:
+		explicit Writer(uint8_t* dst = nullptr) : m_dst(dst) {}
+
+		void bytes(const void* data, size_t size)
+		{
+			if (m_dst && size) memcpy(m_dst + m_offset, data, size);
+			m_offset += size;
+		}
+
+		template<class T>
+		void value(const T& v)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			bytes(&v, sizeof(T));
+		}
+
+		template<class T>
+		void count(const T& container)
+		{
+			value(uint64_t(container.size()));
+		}
+
+		// flat block
+		template<class T>
+		void array(const std::vector<T>& v)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			count(v);
+			align();
+			bytes(v.data(), v.size() * sizeof(T));
+		}
+
+		void string(const std::string& s)
+		{
+			count(s);
+			bytes(s.data(), s.size());
+		}
+
+		void map(const std::map<std::string, std::string>& m)
+		{
+			count(m);
+			for(const auto& [key, val] : m)
+			{
+				string(key);
+				string(val);
+			}
+		}
+
+		void align()
+		{
+			static const uint8_t zeros[8] = {};
+			bytes(zeros, (8 - m_offset % 8) % 8);
+		}
+
+		size_t getOffset() const { return m_offset; }
+	private:
+		uint8_t* m_dst;
+		size_t m_offset = 0;
+	};
+
+	// reads from the mapped file. throws if the file is truncated
+	class Reader
+	{
+	public:
+		Reader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+		void bytes(void* dst, size_t size)
+		{
+			if (size > m_size - m_offset)
+				throw std::runtime_error("file is truncated");
+			if (size) memcpy(dst, m_data + m_offset, size);
+			m_offset += size;
+		}
+
+		template<class T>
+		void value(T& v)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			bytes(&v, sizeof(T));
+		}
+
+		template<class T>
+		void count(T& container)
+		{
+			uint64_t size;
+			value(size);
+			// every element takes at least one byte
+			if (size > m_size - m_offset)
+				throw std::runtime_error("invalid element count");
+			container.resize(size_t(size));
+		}
+
+		template<class T>
+		void array(std::vector<T>& v)
+		{
+			count(v);
+			align();
+			if (v.size() > (m_size - m_offset) / sizeof(T))
+				throw std::runtime_error("file is truncated");
+			bytes(v.data(), v.size() * sizeof(T));
+		}
+
+		void string(std::string& s)
+		{
+			count(s);
+			bytes(s.data(), s.size());
+		}
+
+		void map(std::map<std::string, std::string>& m)
+		{
+			uint64_t size;
+			value(size);
+			for(uint64_t i = 0; i < size; ++i)
+			{
+				std::string key, val;
+				string(key);
+				string(val);
+				m[key] = std::move(val);
+			}
+		}
+
+		void align()
+		{
+			m_offset = std::min(m_offset + (8 - m_offset % 8) % 8, m_size);
+		}
+	private:
+		const uint8_t* m_data;
+		size_t m_size;
+		size_t m_offset = 0;
+	};
+}
+
+// the same field list is used for reading (non-const) and writing (const)
+template<class Archive, class TexOpt>
+static void transferTexOpt(Archive& ar, TexOpt& t)
+{
+	ar.value(t.type);
+	ar.value(t.sharpness);
+	ar.value(t.brightness);
+	ar.value(t.contrast);
+	ar.value(t.origin_offset);
+	ar.value(t.scale);
+	ar.value(t.turbulence);
+	ar.value(t.texture_resolution);
+	ar.value(t.clamp);
+	ar.value(t.imfchan);
+	ar.value(t.blendu);
+	ar.value(t.blendv);
+	ar.value(t.bump_multiplier);
+	ar.string(t.colorspace);
+}
+
+template<class Archive, class Material>
+static void transferMaterial(Archive& ar, Material& m)
+{
+	ar.string(m.name);
+	ar.value(m.ambient);
+	ar.value(m.diffuse);
+	ar.value(m.specular);
+	ar.value(m.transmittance);
+	ar.value(m.emission);
+	ar.value(m.shininess);
+	ar.value(m.ior);
+	ar.value(m.dissolve);
+	ar.value(m.illum);
+	ar.value(m.roughness);
+	ar.value(m.metallic);
+	ar.value(m.sheen);
+	ar.value(m.clearcoat_thickness);
+	ar.value(m.clearcoat_roughness);
+	ar.value(m.anisotropy);
+	ar.value(m.anisotropy_rotation);
+
+	for(auto tex : { &m.ambient_texname, &m.diffuse_texname, &m.specular_texname, &m.specular_highlight_texname,
+		&m.bump_texname, &m.displacement_texname, &m.alpha_texname, &m.reflection_texname,
+		&m.roughness_texname, &m.metallic_texname, &m.sheen_texname, &m.emissive_texname, &m.normal_texname })
+		ar.string(*tex);
+
+	for(auto opt : { &m.ambient_texopt, &m.diffuse_texopt, &m.specular_texopt, &m.specular_highlight_texopt,
+		&m.bump_texopt, &m.displacement_texopt, &m.alpha_texopt, &m.reflection_texopt,
+		&m.roughness_texopt, &m.metallic_texopt, &m.sheen_texopt, &m.emissive_texopt, &m.normal_texopt })
+		transferTexOpt(ar, *opt);
+
+	ar.map(m.unknown_parameter);
+}
+
+template<class Archive, class Attrib, class Shapes, class Materials>
+static void transferObj(Archive& ar, Attrib& attrib, Shapes& shapes, Materials& materials)
+{
+	ar.array(attrib.vertices);
+	ar.array(attrib.normals);
+	ar.array(attrib.texcoords);
+	ar.array(attrib.colors);
+
+	ar.count(shapes);
+	for(auto& s : shapes)
+	{
+		ar.string(s.name);
+		ar.array(s.mesh.indices);
+		ar.array(s.mesh.num_face_vertices);
+		ar.array(s.mesh.material_ids);
+		ar.array(s.mesh.smoothing_group_ids);
+	}
+
+	ar.count(materials);
+	for (auto& m : materials)
+		transferMaterial(ar, m);
+}
+
+template<class Archive, class Sources>
+static void transferSources(Archive& ar, Sources& sources)
+{
+	ar.count(sources);
+	for(auto& s : sources)
+	{
+		ar.string(s.name);
+		ar.value(s.size);
+		ar.value(s.time);
+		ar.value(s.hash);
+	}
+}
+
+bool ObjCache::load(const path& obj, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes, std::vector<tinyobj::material_t>& materials)
+{
+	Profiler::Scope profile("read obj cache");
+	const auto filename = getFilename(obj);
+	if (!std::filesystem::exists(filename)) return false;
+
+	try
+	{
+		MappedFile file(filename);
+		Reader reader(file.getData(), file.getSize());
+
+		char magic[4];
+		uint32_t version;
+		reader.value(magic);
+		reader.value(version);
+		if (memcmp(magic, s_magic, sizeof(magic)) != 0 || version != s_version)
+			return false;
+
+		std::vector<Source> sources;
+		transferSources(reader, sources);
+		for(auto& s : sources)
+		{
+			s.name = (obj.parent_path() / std::filesystem::u8path(s.name)).u8string();
+			if(!isUpToDate(s))
+			{
+				Console::info("obj cache is outdated: " + std::filesystem::u8path(s.name).string() + " changed");
+				return false;
+			}
+		}
+
+		tinyobj::attrib_t a;
+		std::vector<tinyobj::shape_t> sh;
+		std::vector<tinyobj::material_t> m;
+		transferObj(reader, a, sh, m);
+
+		attrib = std::move(a);
+		shapes = std::move(sh);
+		materials = std::move(m);
+		return true;
+	}
+	catch(const std::exception& e)
+	{
+		Console::warning("ignoring obj cache " + filename.string() + ": " + e.what());
+		return false;
+	}
+}
+
+void ObjCache::save(const path& obj, const std::vector<path>& mtlFiles, const tinyobj::attrib_t& attrib,
+	const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::material_t>& materials)
+{
+	Profiler::Scope profile("write obj cache");
+	// names are relative to the obj directory
+	std::vector<Source> sources;
+	sources.push_back(getSource(obj));
+	sources.back().name = obj.filename().u8string();
+	for(const auto& mtl : mtlFiles)
+	{
+		if (!std::filesystem::exists(mtl)) continue; // ignored by the obj loader as well
+		sources.push_back(getSource(mtl));
+		sources.back().name = mtl.lexically_relative(obj.parent_path()).u8string();
+	}
+
+	auto write = [&](Writer& writer)
+	{
+		writer.bytes(s_magic, sizeof(s_magic));
+		writer.value(s_version);
+		transferSources(writer, sources);
+		transferObj(writer, attrib, shapes, materials);
+	};
+
+	// measure => write
+	Writer counter;
+	write(counter);
+
+	// write to a temporary file so that an interrupted write does not leave a broken cache
+	const auto filename = getFilename(obj);
+	auto tmpFilename = filename;
+	tmpFilename.concat(".tmp");
+	{
+		MappedFile file(tmpFilename, counter.getOffset());
+		Writer writer(file.getData());
+		write(writer);
+	}
+	std::filesystem::rename(tmpFilename, filename);
+
+	Console::info("wrote obj cache " + filename.string());
+}
+
+ObjCache::Source ObjCache::getSource(const path& file)
+{
+	Source s;
+	s.size = std::filesystem::file_size(file);
+	s.time = int64_t(std::filesystem::last_write_time(file).time_since_epoch().count());
+	s.hash = XXHash64::hashFile(file);
+	return s;
+}
+
+bool ObjCache::isUpToDate(const Source& source)
+{
+	const auto file = std::filesystem::u8path(source.name);
+	std::error_code ec;
+	const auto size = std::filesystem::file_size(file, ec);
+	if (ec || size != source.size) return false;
+
+	const auto time = std::filesystem::last_write_time(file, ec);
+	if (ec) return false;
+	if (int64_t(time.time_since_epoch().count()) == source.time) return true;
+
+	// file was touched => compare content
+	return XXHash64::hashFile(file) == source.hash;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+#include "../tinyobj/tiny_obj_loader.h"
+
+// binary sidecar (<obj>.objcache) with the parsed obj and mtl files.
+// Arrays are stored as flat 8 byte aligned blocks that are copied directly out of the memory mapped file.
+// The header stores size, write time and hash of every source file to detect outdated caches
+class ObjCache
+{
+public:
+	using path = std::filesystem::path;
+
+	static path getFilename(const path& obj) { return path(obj).concat(".objcache"); }
+
+	/// \brief loads the cache of the obj file
+	/// \return false if there is no cache or if the obj or one of its mtl files changed
+	static bool load(const path& obj, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes, std::vector<tinyobj::material_t>& materials);
+
+	/// \brief writes the cache of the obj file. throws on errors
+	/// \param mtlFiles material libraries of the obj (they invalidate the cache as well)
+	static void save(const path& obj, const std::vector<path>& mtlFiles, const tinyobj::attrib_t& attrib,
+		const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::material_t>& materials);
+private:
+	struct Source
+	{
+		std::string name;
+		uint64_t size = 0;
+		int64_t time = 0;
+		uint64_t hash = 0;
+	};
+
+	static Source getSource(const path& file);
+	/// \brief compares the recorded file with the current one (content hash if only the time changed)
+	static bool isUpToDate(const Source& source);
+};
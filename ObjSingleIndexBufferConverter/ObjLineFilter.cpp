@@ -0,0 +1,42 @@
+#include "ObjLineFilter.h"
+
+ObjLineFilter::ObjLineFilter(std::istream& src, std::vector<std::string> keywords)
+	:
+m_src(src),
+m_keywords(std::move(keywords))
+{}
+
+ObjLineFilter::int_type ObjLineFilter::underflow()
+{
+	if (gptr() < egptr())
+		return traits_type::to_int_type(*gptr());
+
+	while(std::getline(m_src, m_line))
+	{
+		if(isSkipped(m_line))
+		{
+			++m_numSkipped;
+			continue;
+		}
+
+		m_line.push_back('\n');
+		setg(m_line.data(), m_line.data(), m_line.data() + m_line.size());
+		return traits_type::to_int_type(m_line[0]);
+	}
+	return traits_type::eof();
+}
+
+bool ObjLineFilter::isSkipped(const std::string& line) const
+{
+	const auto start = line.find_first_not_of(" \t");
+	if (start == std::string::npos) return false;
+
+	for(const auto& k : m_keywords)
+	{
+		// keyword must be followed by whitespace ("v" must not match "vn")
+		const auto end = start + k.size();
+		if (line.compare(start, k.size(), k) == 0 && end < line.size() && (line[end] == ' ' || line[end] == '\t'))
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <streambuf>
+#include <istream>
+#include <string>
+#include <vector>
+
+// stream buffer that drops obj lines with certain keywords (e.g. "vn", "vt") before they reach the parser.
+// Dropped lines are neither tokenized nor stored by tinyobj
+class ObjLineFilter : public std::streambuf
+{
+public:
+	/// \param src stream with the obj file
+	/// \param keywords line keywords that are removed
+	ObjLineFilter(std::istream& src, std::vector<std::string> keywords);
+
+	/// number of lines that were removed so far
+	size_t getNumSkipped() const { return m_numSkipped; }
+protected:
+	int_type underflow() override;
+private:
+	bool isSkipped(const std::string& line) const;
+
+	std::istream& m_src;
+	std::vector<std::string> m_keywords;
+	std::string m_line;
+	size_t m_numSkipped = 0;
+};
@@ -0,0 +1,360 @@
+#include "PlyLoader.h"
+#include "MappedFile.h"
+#include "Console.h"
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstring>
+#include <cctype>
+#include <map>
+
+bool PlyLoader::isPly(const path& filename)
+{
+	auto ext = filename.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return char(std::tolower(c)); });
+	return ext == ".ply";
+}
+
+void PlyLoader::load(const path& filename, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes,
+	std::vector<tinyobj::material_t>& materials, bool loadNormals, bool loadTexcoords)
+{
+	const auto mtl = getMtlFilename(filename);
+	if(std::filesystem::exists(mtl))
+	{
+		std::ifstream file(mtl);
+		std::map<std::string, int> materialMap;
+		std::string warnings, errors;
+		tinyobj::LoadMtl(&materialMap, &materials, &file, &warnings, &errors);
+		if (!errors.empty())
+			throw std::runtime_error("mtl loader: " + errors);
+		if (!warnings.empty())
+			Console::warning(warnings);
+	}
+
+	MappedFile file(filename);
+	tinyobj::shape_t shape;
+	shape.name = filename.stem().string();
+	try
+	{
+		load(file.getData(), file.getSize(), attrib, shape, materials.size(), loadNormals, loadTexcoords);
+	}
+	catch(const std::exception& e)
+	{
+		throw std::runtime_error(filename.string() + ": " + e.what());
+	}
+	// e.g. point clouds => the converter must not see empty shapes
+	if (!shape.mesh.indices.empty())
+		shapes.push_back(std::move(shape));
+}
+
+void PlyLoader::load(const uint8_t* data, size_t size, tinyobj::attrib_t& attrib, tinyobj::shape_t& shape,
+	size_t numMaterials, bool loadNormals, bool loadTexcoords)
+{
+	std::vector<Element> elements;
+	const uint8_t* cur = data + readHeader(data, size, elements);
+	const uint8_t* end = data + size;
+
+	const uint8_t* vertexData = nullptr;
+	const uint8_t* faceData = nullptr;
+	const Element* vertex = nullptr;
+	const Element* face = nullptr;
+	for(const auto& e : elements)
+	{
+		if (e.name == "vertex") { vertex = &e; vertexData = cur; }
+		else if (e.name == "face") { face = &e; faceData = cur; }
+		// the size of the face element requires a walk over all faces
+		if (vertex && face) break;
+		cur += getDataSize(e, cur, end);
+	}
+	if (!vertex || !vertex->count)
+		throw std::runtime_error("no vertices found");
+	if (!vertex->stride)
+		throw std::runtime_error("list properties in vertices are not supported");
+	if (vertex->count > size_t(end - vertexData) / vertex->stride)
+		throw std::runtime_error("unexpected end of file");
+
+	const Property* pos[] = { vertex->find({ "x" }), vertex->find({ "y" }), vertex->find({ "z" }) };
+	const Property* nrm[] = { vertex->find({ "nx" }), vertex->find({ "ny" }), vertex->find({ "nz" }) };
+	const Property* uv[] = { vertex->find({ "u", "s", "texture_u", "texture_s" }), vertex->find({ "v", "t", "texture_v", "texture_t" }) };
+	if (!pos[0] || !pos[1] || !pos[2])
+		throw std::runtime_error("vertex positions are missing");
+	const bool hasNormals = loadNormals && nrm[0] && nrm[1] && nrm[2];
+	const bool hasTexcoords = loadTexcoords && uv[0] && uv[1];
+
+	// vertices have a fixed size => converted in parallel
+	const size_t vertexOffset = attrib.vertices.size() / 3;
+	const size_t numVertices = vertex->count;
+	attrib.vertices.resize(attrib.vertices.size() + numVertices * 3);
+	if (hasNormals) attrib.normals.resize(attrib.normals.size() + numVertices * 3);
+	if (hasTexcoords) attrib.texcoords.resize(attrib.texcoords.size() + numVertices * 2);
+	auto convert = [&](const Property* const* props, size_t numProps, std::vector<tinyobj::real_t>& dst)
+	{
+		auto out = dst.data() + vertexOffset * numProps;
+		const size_t chunkSize = 1 << 16;
+		std::vector<size_t> chunks((numVertices + chunkSize - 1) / chunkSize);
+		std::iota(chunks.begin(), chunks.end(), size_t(0));
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](size_t chunk)
+		{
+			const auto last = std::min(numVertices, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < last; ++i)
+			{
+				const uint8_t* src = vertexData + i * vertex->stride;
+				for(size_t p = 0; p < numProps; ++p)
+				{
+					if (props[p]->type == Type::Float32)
+						memcpy(&out[i * numProps + p], src + props[p]->offset, sizeof(float));
+					else
+						out[i * numProps + p] = tinyobj::real_t(read(props[p]->type, src + props[p]->offset));
+				}
+			}
+		});
+	};
+	convert(pos, 3, attrib.vertices);
+	if (hasNormals) convert(nrm, 3, attrib.normals);
+	if (hasTexcoords) convert(uv, 2, attrib.texcoords);
+
+	if (!face || !face->count) return;
+
+	const Property* materialProp = face->find({ "material_index" });
+	size_t numInvalidMaterials = 0;
+	auto& mesh = shape.mesh;
+	mesh.indices.reserve(mesh.indices.size() + face->count * 3);
+	mesh.num_face_vertices.reserve(mesh.num_face_vertices.size() + face->count);
+	mesh.material_ids.reserve(mesh.material_ids.size() + face->count);
+
+	auto index = [&](uint32_t i)
+	{
+		if (i >= numVertices)
+			throw std::runtime_error("vertex index out of range");
+		tinyobj::index_t res;
+		res.vertex_index = int(vertexOffset + i);
+		res.normal_index = hasNormals ? res.vertex_index : -1;
+		res.texcoord_index = hasTexcoords ? res.vertex_index : -1;
+		return res;
+	};
+
+	std::vector<uint32_t> polygon;
+	cur = faceData;
+	for(size_t f = 0; f < face->count; ++f)
+	{
+		polygon.clear();
+		int material = -1;
+		for(const auto& p : face->properties)
+		{
+			if (getSize(p.isList ? p.countType : p.type) > size_t(end - cur))
+				throw std::runtime_error("unexpected end of file");
+			if(p.isList)
+			{
+				const auto count = size_t(read(p.countType, cur));
+				cur += getSize(p.countType);
+				const auto elementSize = getSize(p.type);
+				if (count * elementSize > size_t(end - cur))
+					throw std::runtime_error("unexpected end of file");
+				if (p.name == "vertex_indices" || p.name == "vertex_index")
+				{
+					polygon.resize(count);
+					if (p.type == Type::Int32 || p.type == Type::Uint32)
+						memcpy(polygon.data(), cur, count * sizeof(uint32_t));
+					else
+						for (size_t i = 0; i < count; ++i)
+							polygon[i] = uint32_t(read(p.type, cur + i * elementSize));
+				}
+				cur += count * elementSize;
+				continue;
+			}
+
+			if (&p == materialProp)
+			{
+				const auto id = int64_t(read(p.type, cur));
+				if (id >= 0 && size_t(id) < numMaterials) material = int(id);
+				else if (id >= 0) ++numInvalidMaterials;
+			}
+			cur += getSize(p.type);
+		}
+
+		// triangle fan
+		for(size_t i = 1; i + 1 < polygon.size(); ++i)
+		{
+			mesh.indices.push_back(index(polygon[0]));
+			mesh.indices.push_back(index(polygon[i]));
+			mesh.indices.push_back(index(polygon[i + 1]));
+			mesh.num_face_vertices.push_back(3);
+			mesh.material_ids.push_back(material);
+		}
+	}
+
+	if (numInvalidMaterials)
+		Console::warning(std::to_string(numInvalidMaterials) + " ply faces reference missing materials and use the default material");
+}
+
+size_t PlyLoader::readHeader(const uint8_t* data, size_t size, std::vector<Element>& elements)
+{
+	static const char s_endHeader[] = "end_header";
+	const auto* end = data + size;
+	const auto* headerEnd = std::search(data, end, s_endHeader, s_endHeader + sizeof(s_endHeader) - 1);
+	if (headerEnd == end)
+		throw std::runtime_error("ply header is incomplete");
+	headerEnd += sizeof(s_endHeader) - 1;
+	// line ending
+	if (headerEnd != end && *headerEnd == '\r') ++headerEnd;
+	if (headerEnd == end || *headerEnd != '\n')
+		throw std::runtime_error("ply header is incomplete");
+	++headerEnd;
+
+	std::istringstream header(std::string(reinterpret_cast<const char*>(data), headerEnd - data));
+	std::string line;
+	std::getline(header, line);
+	if (line.compare(0, 3, "ply") != 0)
+		throw std::runtime_error("not a ply file");
+
+	while(std::getline(header, line))
+	{
+		std::istringstream tokens(line);
+		std::string keyword;
+		tokens >> keyword;
+		if(keyword == "format")
+		{
+			std::string format;
+			tokens >> format;
+			if (format != "binary_little_endian")
+				throw std::runtime_error("only binary little endian ply files are supported (found " + format + ")");
+		}
+		else if(keyword == "element")
+		{
+			Element e;
+			tokens >> e.name >> e.count;
+			elements.push_back(std::move(e));
+		}
+		else if(keyword == "property")
+		{
+			if (elements.empty())
+				throw std::runtime_error("ply property without element");
+			Property p;
+			std::string type;
+			tokens >> type;
+			if(type == "list")
+			{
+				p.isList = true;
+				tokens >> type;
+				p.countType = getType(type);
+				tokens >> type;
+			}
+			p.type = getType(type);
+			tokens >> p.name;
+			elements.back().properties.push_back(std::move(p));
+		}
+		// comment, obj_info and end_header are ignored
+	}
+
+	// offsets for elements without lists
+	for(auto& e : elements)
+	{
+		size_t offset = 0;
+		for(auto& p : e.properties)
+		{
+			if (p.isList) { offset = 0; break; }
+			p.offset = offset;
+			offset += getSize(p.type);
+		}
+		e.stride = offset;
+	}
+
+	return size_t(headerEnd - data);
+}
+
+const PlyLoader::Property* PlyLoader::Element::find(std::initializer_list<const char*> names) const
+{
+	for(const auto& p : properties)
+		for (const auto* n : names)
+			if (p.name == n && !p.isList) return &p;
+	return nullptr;
+}
+
+PlyLoader::Type PlyLoader::getType(const std::string& name)
+{
+	static const std::map<std::string, Type> s_types = {
+		{ "char", Type::Int8 }, { "int8", Type::Int8 },
+		{ "uchar", Type::Uint8 }, { "uint8", Type::Uint8 },
+		{ "short", Type::Int16 }, { "int16", Type::Int16 },
+		{ "ushort", Type::Uint16 }, { "uint16", Type::Uint16 },
+		{ "int", Type::Int32 }, { "int32", Type::Int32 },
+		{ "uint", Type::Uint32 }, { "uint32", Type::Uint32 },
+		{ "float", Type::Float32 }, { "float32", Type::Float32 },
+		{ "double", Type::Float64 }, { "float64", Type::Float64 },
+	};
+	const auto it = s_types.find(name);
+	if (it == s_types.end())
+		throw std::runtime_error("unknown ply property type " + name);
+	return it->second;
+}
+
+size_t PlyLoader::getSize(Type type)
+{
+	switch(type)
+	{
+	case Type::Int8:
+	case Type::Uint8: return 1;
+	case Type::Int16:
+	case Type::Uint16: return 2;
+	case Type::Int32:
+	case Type::Uint32:
+	case Type::Float32: return 4;
+	case Type::Float64: return 8;
+	}
+	return 0;
+}
+
+double PlyLoader::read(Type type, const uint8_t* src)
+{
+	// the data is not aligned
+	auto get = [src](auto value)
+	{
+		memcpy(&value, src, sizeof(value));
+		return double(value);
+	};
+
+	switch(type)
+	{
+	case Type::Int8: return get(int8_t());
+	case Type::Uint8: return get(uint8_t());
+	case Type::Int16: return get(int16_t());
+	case Type::Uint16: return get(uint16_t());
+	case Type::Int32: return get(int32_t());
+	case Type::Uint32: return get(uint32_t());
+	case Type::Float32: return get(float());
+	case Type::Float64: return get(double());
+	}
+	return 0.0;
+}
+
+size_t PlyLoader::getDataSize(const Element& e, const uint8_t* data, const uint8_t* end)
+{
+	const auto available = size_t(end - data);
+	if(e.stride || e.properties.empty())
+	{
+		if (e.stride && e.count > available / e.stride)
+			throw std::runtime_error("unexpected end of file in element " + e.name);
+		return e.count * e.stride;
+	}
+
+	// lists => every entry has to be visited
+	size_t offset = 0;
+	for(size_t i = 0; i < e.count; ++i)
+	{
+		for(const auto& p : e.properties)
+		{
+			size_t bytes = getSize(p.isList ? p.countType : p.type);
+			if (offset + bytes > available)
+				throw std::runtime_error("unexpected end of file in element " + e.name);
+			if (p.isList)
+				bytes += size_t(read(p.countType, data + offset)) * getSize(p.type);
+			offset += bytes;
+		}
+	}
+	if (offset > available)
+		throw std::runtime_error("unexpected end of file in element " + e.name);
+	return offset;
+}
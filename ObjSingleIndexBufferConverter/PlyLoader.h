@@ -0,0 +1,67 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "../tinyobj/tiny_obj_loader.h"
+
+// loader for binary little endian ply files (e.g. photogrammetry scans).
+// The file is memory mapped and converted into the tinyobj structures that are used for obj files:
+// vertex properties x y z, nx ny nz, u v (or s t), the face list vertex_indices and the optional face property material_index.
+// Material indices refer to the materials of <name>.mtl (in file order)
+class PlyLoader
+{
+public:
+	using path = std::filesystem::path;
+
+	static bool isPly(const path& filename);
+	/// \brief material library that is used for the material indices
+	static path getMtlFilename(const path& ply) { return path(ply).replace_extension(".mtl"); }
+
+	/// \brief loads the ply file and its material library (if it exists). throws on errors.
+	/// No shape is added if the file has no faces (point clouds)
+	/// \param loadNormals, loadTexcoords unused attributes are not converted
+	static void load(const path& filename, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes,
+		std::vector<tinyobj::material_t>& materials, bool loadNormals = true, bool loadTexcoords = true);
+
+	/// \brief converts a ply file that is already in memory into a single shape. throws on errors
+	/// \param numMaterials face material indices outside [0, numMaterials) are replaced by -1
+	static void load(const uint8_t* data, size_t size, tinyobj::attrib_t& attrib, tinyobj::shape_t& shape,
+		size_t numMaterials, bool loadNormals = true, bool loadTexcoords = true);
+private:
+	enum class Type
+	{
+		Int8, Uint8, Int16, Uint16, Int32, Uint32, Float32, Float64
+	};
+
+	struct Property
+	{
+		std::string name;
+		Type type = Type::Float32;
+		// list properties: type of the element count
+		bool isList = false;
+		Type countType = Type::Uint8;
+		// byte offset in elements without lists
+		size_t offset = 0;
+	};
+
+	struct Element
+	{
+		std::string name;
+		size_t count = 0;
+		std::vector<Property> properties;
+		// size of one entry, 0 if the element contains lists
+		size_t stride = 0;
+
+		const Property* find(std::initializer_list<const char*> names) const;
+	};
+
+	/// \brief parses the ascii header
+	/// \return offset of the binary data
+	static size_t readHeader(const uint8_t* data, size_t size, std::vector<Element>& elements);
+	static Type getType(const std::string& name);
+	static size_t getSize(Type type);
+	static double read(Type type, const uint8_t* src);
+	/// \brief byte size of all entries of the element
+	static size_t getDataSize(const Element& e, const uint8_t* data, const uint8_t* end);
+};
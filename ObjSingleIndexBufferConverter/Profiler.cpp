@@ -0,0 +1,174 @@
+#include "Profiler.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <map>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include "../json/single_include/nlohmann/json.hpp"
+#include "Console.h"
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "Psapi.lib")
+
+using json = nlohmann::json;
+
+struct Event
+{
+	const char* name;
+	uint32_t thread;
+	// microseconds since the start of the process
+	int64_t start;
+	int64_t duration;
+	uint64_t memory;
+	uint64_t peakMemory;
+};
+
+static std::atomic<bool> s_enabled = false;
+static std::mutex s_mutex;
+static std::vector<Event> s_events;
+static const auto s_startTime = std::chrono::steady_clock::now();
+
+// small ids for the trace lanes
+static uint32_t getThreadIndex()
+{
+	static std::atomic<uint32_t> s_nextIndex = 0;
+	thread_local const uint32_t index = s_nextIndex++;
+	return index;
+}
+
+static int64_t getTime()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_startTime).count();
+}
+
+static PROCESS_MEMORY_COUNTERS getMemoryCounters()
+{
+	PROCESS_MEMORY_COUNTERS counters = {};
+	counters.cb = sizeof(counters);
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return {};
+	return counters;
+}
+
+Profiler::Scope::Scope(const char* name)
+	:
+m_name(name)
+{
+	if (s_enabled) m_start = getTime();
+}
+
+Profiler::Scope::~Scope()
+{
+	if (m_start < 0 || !s_enabled) return;
+	const auto end = getTime();
+	const auto memory = getMemoryCounters();
+	const Event e = { m_name, getThreadIndex(), m_start, end - m_start, memory.WorkingSetSize, memory.PeakWorkingSetSize };
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_events.push_back(e);
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+	// the main thread gets the first lane
+	getThreadIndex();
+	s_enabled = enabled;
+}
+
+bool Profiler::isEnabled()
+{
+	return s_enabled;
+}
+
+void Profiler::reset()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_events.clear();
+}
+
+std::vector<Profiler::Stage> Profiler::getStages()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	std::vector<Event> events = s_events;
+	// events are recorded when they end => nested stages come first
+	std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.start < b.start; });
+
+	std::vector<Stage> stages;
+	std::map<std::string, size_t> indices;
+	for(const auto& e : events)
+	{
+		auto it = indices.find(e.name);
+		if(it == indices.end())
+		{
+			it = indices.emplace(e.name, stages.size()).first;
+			stages.emplace_back();
+			stages.back().name = e.name;
+		}
+		auto& s = stages[it->second];
+		++s.count;
+		s.totalMs += double(e.duration) / 1000.0;
+		s.peakMemory = std::max(s.peakMemory, e.peakMemory);
+	}
+	return stages;
+}
+
+void Profiler::writeTrace(const std::filesystem::path& filename)
+{
+	json events = json::array();
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		uint32_t numThreads = 0;
+		for(const auto& e : s_events)
+		{
+			events.push_back({
+				{ "name", e.name }, { "cat", "stage" }, { "ph", "X" }, { "pid", 1 }, { "tid", e.thread },
+				{ "ts", e.start }, { "dur", e.duration },
+				{ "args", { { "memory MB", double(e.memory) / (1024.0 * 1024.0) }, { "peak memory MB", double(e.peakMemory) / (1024.0 * 1024.0) } } }
+			});
+			// memory lane
+			events.push_back({
+				{ "name", "memory" }, { "ph", "C" }, { "pid", 1 }, { "ts", e.start + e.duration },
+				{ "args", { { "working set MB", double(e.memory) / (1024.0 * 1024.0) } } }
+			});
+			numThreads = std::max(numThreads, e.thread + 1);
+		}
+
+		for(uint32_t i = 0; i < numThreads; ++i)
+		{
+			events.push_back({
+				{ "name", "thread_name" }, { "ph", "M" }, { "pid", 1 }, { "tid", i },
+				{ "args", { { "name", i == 0 ? std::string("main") : "worker " + std::to_string(i) } } }
+			});
+		}
+	}
+
+	std::ofstream file(filename);
+	if (!file.is_open())
+		throw std::runtime_error("could not write profile " + filename.string());
+	file << json{ { "traceEvents", events }, { "displayTimeUnit", "ms" } };
+	Console::info("wrote profile to " + filename.string());
+}
+
+void Profiler::printStages()
+{
+	for(const auto& s : getStages())
+	{
+		Console::info(s.name + ": " + std::to_string(int64_t(s.totalMs)) + " ms (" + std::to_string(s.count) + "x), peak memory "
+			+ std::to_string(s.peakMemory >> 20) + " MB");
+	}
+}
+
+uint64_t Profiler::getCurrentMemory()
+{
+	return getMemoryCounters().WorkingSetSize;
+}
+
+uint64_t Profiler::getPeakMemory()
+{
+	return getMemoryCounters().PeakWorkingSetSize;
+}
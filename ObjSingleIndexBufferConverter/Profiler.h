@@ -0,0 +1,55 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// records the duration and memory usage of the conversion stages.
+// Disabled by default => scopes only check a flag
+class Profiler
+{
+public:
+	Profiler() = delete;
+
+	/// \brief measures the time from construction to destruction as one event of the calling thread
+	class Scope
+	{
+	public:
+		/// \param name stage name (must be a string literal)
+		explicit Scope(const char* name);
+		~Scope();
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		const char* m_name;
+		int64_t m_start = -1;
+	};
+
+	/// \brief accumulated events of one stage
+	struct Stage
+	{
+		std::string name;
+		size_t count = 0;
+		// sum over all threads
+		double totalMs = 0.0;
+		// process peak working set at the end of the last event
+		uint64_t peakMemory = 0;
+	};
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+	/// \brief removes all recorded events
+	static void reset();
+
+	/// \brief stages in the order of their first event
+	static std::vector<Stage> getStages();
+	/// \brief writes all events in the chrome trace event format (chrome://tracing, perfetto) with one lane per thread
+	static void writeTrace(const std::filesystem::path& filename);
+	/// \brief prints the stage summary
+	static void printStages();
+
+	/// \brief current working set of the process in bytes
+	static uint64_t getCurrentMemory();
+	/// \brief peak working set of the process in bytes
+	static uint64_t getPeakMemory();
+};
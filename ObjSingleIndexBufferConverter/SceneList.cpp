@@ -0,0 +1,105 @@
+#include "SceneList.h"
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include "../json/single_include/nlohmann/json.hpp"
+#include "Console.h"
+
+using json = nlohmann::json;
+
+// single number => same value for all components
+static glm::vec3 getVec3(const json& j)
+{
+	if (j.is_number()) return glm::vec3(j.get<float>());
+	const auto v = j.get<std::vector<float>>();
+	if (v.size() != 3)
+		throw std::runtime_error("scene list: expected 3 components");
+	return glm::vec3(v[0], v[1], v[2]);
+}
+
+// matrix (16 values, row major) or translate * rotate (euler angles in degrees, x first) * scale
+static glm::mat4 getTransform(const json& e)
+{
+	if(e.contains("matrix"))
+	{
+		const auto m = e.at("matrix").get<std::vector<float>>();
+		if (m.size() != 16)
+			throw std::runtime_error("scene list: matrix requires 16 values");
+		// glm is column major
+		glm::mat4 res;
+		for (int row = 0; row < 4; ++row)
+			for (int col = 0; col < 4; ++col)
+				res[col][row] = m[row * 4 + col];
+		return res;
+	}
+
+	glm::mat4 res(1.0f);
+	if (e.contains("translate"))
+		res = glm::translate(res, getVec3(e.at("translate")));
+	if(e.contains("rotate"))
+	{
+		const auto angles = glm::radians(getVec3(e.at("rotate")));
+		res = glm::rotate(res, angles.z, glm::vec3(0.0f, 0.0f, 1.0f));
+		res = glm::rotate(res, angles.y, glm::vec3(0.0f, 1.0f, 0.0f));
+		res = glm::rotate(res, angles.x, glm::vec3(1.0f, 0.0f, 0.0f));
+	}
+	if (e.contains("scale"))
+		res = glm::scale(res, getVec3(e.at("scale")));
+	return res;
+}
+
+SceneList::SceneList(const std::filesystem::path& filename)
+{
+	std::ifstream file(filename);
+	if (!file.is_open())
+		throw std::runtime_error("could not open scene list " + filename.string());
+
+	json j;
+	file >> j;
+
+	const auto base = filename.parent_path();
+	for(const auto& e : j.at("inputs"))
+	{
+		Input input;
+		if(e.is_string())
+		{
+			input.file = base / std::filesystem::u8path(e.get<std::string>());
+		}
+		else
+		{
+			input.file = base / std::filesystem::u8path(e.at("file").get<std::string>());
+			input.transform = getTransform(e);
+		}
+		// absolute => the common root below is only empty if the inputs are on different drives
+		input.file = std::filesystem::absolute(input.file).lexically_normal();
+		m_inputs.push_back(std::move(input));
+	}
+	if (m_inputs.empty())
+		throw std::runtime_error("scene list " + filename.string() + " has no inputs");
+
+	// longest common directory prefix
+	m_root = m_inputs[0].file.parent_path();
+	for(const auto& input : m_inputs)
+	{
+		const auto dir = input.file.parent_path();
+		std::filesystem::path common;
+		auto a = m_root.begin();
+		auto b = dir.begin();
+		for (; a != m_root.end() && b != dir.end() && *a == *b; ++a, ++b)
+			common /= *a;
+		m_root = common;
+	}
+	// texture paths could not be expressed relative to the root
+	if (m_root.empty())
+		throw std::runtime_error("inputs of scene list " + filename.string() + " do not share a common directory (different drives?)");
+
+	Console::info("loaded " + std::to_string(m_inputs.size()) + " inputs from " + filename.string());
+}
+
+bool SceneList::isSceneList(const std::filesystem::path& filename)
+{
+	auto ext = filename.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return char(std::tolower(c)); });
+	return ext == ".json";
+}
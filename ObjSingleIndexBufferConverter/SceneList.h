@@ -0,0 +1,30 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+#include "glm.h"
+
+// list of obj (or ply) files that are merged into one scene (see main.cpp for the format).
+// Every input can be placed with its own transformation
+class SceneList
+{
+public:
+	struct Input
+	{
+		std::filesystem::path file;
+		// object to scene transformation
+		glm::mat4 transform = glm::mat4(1.0f);
+	};
+
+	/// \brief loads the list. throws on errors
+	explicit SceneList(const std::filesystem::path& filename);
+
+	/// \brief indicates if the converter input is a scene list instead of a single file
+	static bool isSceneList(const std::filesystem::path& filename);
+
+	const std::vector<Input>& getInputs() const { return m_inputs; }
+	/// \brief common parent directory of all inputs. Texture paths are relative to this directory
+	const std::filesystem::path& getRoot() const { return m_root; }
+private:
+	std::vector<Input> m_inputs;
+	std::filesystem::path m_root;
+};
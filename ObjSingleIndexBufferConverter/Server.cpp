@@ -0,0 +1,328 @@
+#include "Server.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include "../json/single_include/nlohmann/json.hpp"
+#include "Console.h"
+#include "TextureConverter.h"
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <afunix.h>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+using json = nlohmann::json;
+
+// progress events are sent at most this often (per job)
+static constexpr auto s_progressInterval = std::chrono::milliseconds(250);
+
+struct Server::Connection
+{
+	explicit Connection(SOCKET socket) : socket(socket) {}
+	~Connection() { closesocket(socket); }
+
+	/// \brief sends a single event line. Errors are ignored (client disconnected)
+	void send(const json& event)
+	{
+		const auto line = event.dump() + '\n';
+		std::lock_guard<std::mutex> lock(mutex);
+		if (closed) return;
+		for(size_t offset = 0; offset < line.size();)
+		{
+			const int count = ::send(socket, line.data() + offset, int(line.size() - offset), 0);
+			if (count == SOCKET_ERROR)
+			{
+				closed = true;
+				return;
+			}
+			offset += size_t(count);
+		}
+	}
+
+	SOCKET socket;
+	std::mutex mutex;
+	bool closed = false;
+};
+
+// forwards the console output of a job to its client
+class Server::JobSink : public Console::Sink
+{
+public:
+	JobSink(Connection& client, uint64_t id) : m_client(client), m_id(id) {}
+
+	void message(const char* type, const std::string& text) override
+	{
+		m_client.send({ {"job", m_id}, {"event", type}, {"text", text} });
+	}
+
+	void progress(const char* what, size_t curCount, size_t totalCount) override
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (what == m_lastProgress && curCount != totalCount && now - m_lastTime < s_progressInterval)
+			return;
+		m_lastProgress = what;
+		m_lastTime = now;
+		m_client.send({ {"job", m_id}, {"event", "progress"}, {"what", what}, {"current", curCount}, {"total", totalCount} });
+	}
+private:
+	Connection& m_client;
+	uint64_t m_id;
+	const char* m_lastProgress = nullptr;
+	std::chrono::steady_clock::time_point m_lastTime;
+};
+
+Server::Server(std::filesystem::path socket)
+	:
+m_socketPath(std::move(socket)),
+m_socket(INVALID_SOCKET)
+{
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+		throw std::runtime_error("could not initialize winsock");
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	const auto name = m_socketPath.string();
+	if (name.size() >= sizeof(address.sun_path))
+	{
+		WSACleanup();
+		throw std::runtime_error("socket path is too long: " + name);
+	}
+	std::copy(name.begin(), name.end(), address.sun_path);
+
+	// socket file of a previous server that was not shut down
+	std::error_code ec;
+	std::filesystem::remove(m_socketPath, ec);
+
+	m_socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_socket == INVALID_SOCKET ||
+		bind(m_socket, reinterpret_cast<const sockaddr*>(&address), int(sizeof(address))) == SOCKET_ERROR ||
+		listen(m_socket, SOMAXCONN) == SOCKET_ERROR)
+	{
+		const auto error = WSAGetLastError();
+		if (m_socket != INVALID_SOCKET) closesocket(m_socket);
+		WSACleanup();
+		throw std::runtime_error("could not listen on " + name + " (error " + std::to_string(error) + ")");
+	}
+}
+
+Server::~Server()
+{
+	stop();
+	WSACleanup();
+	std::error_code ec;
+	std::filesystem::remove(m_socketPath, ec);
+}
+
+void Server::run(const Configure& configure, size_t numWorkers)
+{
+	if (numWorkers == 0)
+		numWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < numWorkers; ++i)
+		workers.emplace_back([&]() { work(configure); });
+
+	Console::info("listening on " + m_socketPath.string() + " with " + std::to_string(numWorkers) + " workers");
+
+	SOCKET listener;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		listener = m_socket;
+	}
+
+	struct Receiver
+	{
+		std::thread thread;
+		std::shared_ptr<std::atomic<bool>> finished;
+	};
+	std::vector<Receiver> receivers;
+	while(true)
+	{
+		const SOCKET socket = accept(listener, nullptr, nullptr);
+		if (socket == INVALID_SOCKET) break; // closed by stop()
+
+		// clean up after clients that disconnected
+		for(auto it = receivers.begin(); it != receivers.end();)
+		{
+			if (!*it->finished)
+			{
+				++it;
+				continue;
+			}
+			it->thread.join();
+			it = receivers.erase(it);
+		}
+
+		auto client = std::make_shared<Connection>(socket);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(), [](const std::weak_ptr<Connection>& c)
+			{
+				return c.expired();
+			}), m_clients.end());
+			m_clients.push_back(client);
+		}
+		auto finished = std::make_shared<std::atomic<bool>>(false);
+		receivers.push_back({ std::thread([this, client, finished]()
+		{
+			receive(client);
+			*finished = true;
+		}), finished });
+	}
+
+	// finish the queued jobs
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_jobAvailable.notify_all();
+	for (auto& w : workers)
+		w.join();
+
+	// wake up the receivers
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const auto& c : m_clients)
+			if (auto client = c.lock())
+				shutdown(client->socket, SD_BOTH);
+	}
+	for (auto& r : receivers)
+		r.thread.join();
+
+	Console::info("server stopped");
+}
+
+void Server::receive(std::shared_ptr<Connection> client)
+{
+	std::string buffer;
+	char chunk[4096];
+	while(true)
+	{
+		const int count = recv(client->socket, chunk, int(sizeof(chunk)), 0);
+		if (count <= 0) break;
+		buffer.append(chunk, size_t(count));
+
+		// one request per line
+		size_t end;
+		while((end = buffer.find('\n')) != std::string::npos)
+		{
+			const auto line = buffer.substr(0, end);
+			buffer.erase(0, end + 1);
+			if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+			handleRequest(client, line);
+		}
+	}
+}
+
+void Server::handleRequest(const std::shared_ptr<Connection>& client, const std::string& line)
+{
+	try
+	{
+		const auto request = json::parse(line);
+		if(request.contains("command"))
+		{
+			const auto command = request.at("command").get<std::string>();
+			if (command != "shutdown")
+				throw std::runtime_error("unknown command " + command);
+			client->send({ {"event", "shutdown"} });
+			stop();
+			return;
+		}
+
+		Job job;
+		job.input = std::filesystem::u8path(request.at("input").get<std::string>());
+		job.output = std::filesystem::u8path(request.at("output").get<std::string>());
+		job.priority = request.value("priority", 0);
+		job.client = client;
+		if(request.contains("flags"))
+			job.flags = Batch::parseFlags(request.at("flags"));
+
+		size_t position;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_stopping)
+				throw std::runtime_error("server is shutting down");
+			job.id = m_nextId++;
+			position = m_jobs.size();
+		}
+		// a slow client must not block the other receivers and workers.
+		// The job is queued afterwards => "queued" is always sent before "started"
+		client->send({ {"job", job.id}, {"event", "queued"}, {"position", position} });
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_stopping)
+				throw std::runtime_error("server is shutting down");
+			m_jobs.push(std::move(job));
+		}
+		m_jobAvailable.notify_one();
+	}
+	catch(const std::exception& e)
+	{
+		client->send({ {"event", "error"}, {"text", std::string("invalid request: ") + e.what()} });
+	}
+}
+
+void Server::work(const Configure& configure)
+{
+	while(true)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_jobAvailable.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+		if (m_jobs.empty()) return; // stopping
+		const Job job = m_jobs.top();
+		m_jobs.pop();
+		lock.unlock();
+
+		runJob(job, configure);
+	}
+}
+
+void Server::runJob(const Job& job, const Configure& configure)
+{
+	JobSink sink(*job.client, job.id);
+	Console::setThreadSink(&sink);
+	job.client->send({ {"job", job.id}, {"event", "started"} });
+
+	bool success = true;
+	try
+	{
+		// argument set expects mutable c strings
+		std::vector<std::string> flags = job.flags;
+		std::vector<char*> argv;
+		for (auto& f : flags)
+			argv.push_back(f.data());
+
+		// keep the texture cache of the destination loaded for the next jobs
+		auto cache = TextureCache::get(TextureConverter::getCacheManifest(job.output.parent_path()));
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (std::find(m_caches.begin(), m_caches.end(), cache) == m_caches.end())
+				m_caches.push_back(cache);
+		}
+
+		Converter converter;
+		configure(converter, int(argv.size()), argv.data());
+		converter.convert(job.input, job.output);
+		converter.printStats();
+	}
+	catch(const std::exception& e)
+	{
+		Console::error(job.input.string() + ": " + e.what());
+		success = false;
+	}
+
+	Console::setThreadSink(nullptr);
+	job.client->send({ {"job", job.id}, {"event", "finished"}, {"success", success} });
+}
+
+void Server::stop()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_socket == INVALID_SOCKET) return;
+	closesocket(m_socket);
+	m_socket = INVALID_SOCKET;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "Batch.h"
+#include "TextureCache.h"
+
+// local conversion service (see main.cpp for the protocol).
+// Jobs are received over a unix domain socket, queued by priority and converted by a fixed number of workers.
+// Progress and messages of a job are streamed back to the client that submitted it
+class Server
+{
+public:
+	using Configure = Batch::Configure;
+
+	/// \brief creates the socket and starts listening. throws on errors
+	explicit Server(std::filesystem::path socket);
+	~Server();
+	Server(const Server&) = delete;
+	Server& operator=(const Server&) = delete;
+
+	/// \brief accepts clients and converts their jobs until a client sends the shutdown command.
+	/// Jobs that were already queued are finished before returning
+	/// \param numWorkers number of jobs that run at the same time (0 = number of cores)
+	void run(const Configure& configure, size_t numWorkers);
+private:
+	struct Connection;
+	class JobSink;
+
+	struct Job
+	{
+		uint64_t id = 0;
+		int priority = 0;
+		std::filesystem::path input;
+		std::filesystem::path output;
+		std::vector<std::string> flags;
+		std::shared_ptr<Connection> client;
+
+		// higher priority first, same priority in submission order
+		bool operator<(const Job& o) const
+		{
+			if (priority != o.priority) return priority < o.priority;
+			return id > o.id;
+		}
+	};
+
+	/// \brief reads requests from a client until it disconnects
+	void receive(std::shared_ptr<Connection> client);
+	/// \brief handles a single request line
+	void handleRequest(const std::shared_ptr<Connection>& client, const std::string& line);
+	void work(const Configure& configure);
+	void runJob(const Job& job, const Configure& configure);
+	/// \brief closes the listening socket => run() stops accepting clients
+	void stop();
+
+	std::filesystem::path m_socketPath;
+	uintptr_t m_socket;
+
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::priority_queue<Job> m_jobs;
+	uint64_t m_nextId = 1;
+	bool m_stopping = false;
+	std::vector<std::weak_ptr<Connection>> m_clients;
+	// texture caches stay loaded between jobs
+	std::vector<std::shared_ptr<TextureCache>> m_caches;
+};
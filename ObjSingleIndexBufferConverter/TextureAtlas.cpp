@@ -0,0 +1,179 @@
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <climits>
+
+static int alignUp(int value)
+{
+	return (value + TextureAtlas::Alignment - 1) / TextureAtlas::Alignment * TextureAtlas::Alignment;
+}
+
+TextureAtlas::Skyline::Skyline(int size)
+	:
+m_size(size)
+{
+	m_segments.push_back({ 0, 0, size });
+}
+
+bool TextureAtlas::Skyline::insert(int width, int height, int& x, int& y)
+{
+	int bestY = INT_MAX;
+	size_t bestSegment = m_segments.size();
+	for(size_t i = 0; i < m_segments.size(); ++i)
+	{
+		const int startX = m_segments[i].x;
+		if (startX + width > m_size) break;
+
+		// the rectangle rests on the highest segment below it
+		int top = 0;
+		int remaining = width;
+		for(size_t j = i; remaining > 0; ++j)
+		{
+			top = std::max(top, m_segments[j].y);
+			remaining -= m_segments[j].width;
+		}
+
+		if(top + height <= m_size && top < bestY)
+		{
+			bestY = top;
+			bestSegment = i;
+		}
+	}
+	if (bestSegment == m_segments.size()) return false;
+
+	x = m_segments[bestSegment].x;
+	y = bestY;
+
+	// replace the covered segments with the new one
+	const int right = x + width;
+	auto it = m_segments.begin() + bestSegment;
+	while(it != m_segments.end() && it->x < right)
+	{
+		const int segmentRight = it->x + it->width;
+		if(segmentRight <= right)
+		{
+			it = m_segments.erase(it);
+			continue;
+		}
+		// partially covered
+		it->width = segmentRight - right;
+		it->x = right;
+		break;
+	}
+	it = m_segments.insert(it, { x, y + height, width });
+
+	// merge neighbors with the same height
+	for(size_t i = 0; i + 1 < m_segments.size();)
+	{
+		if(m_segments[i].y == m_segments[i + 1].y)
+		{
+			m_segments[i].width += m_segments[i + 1].width;
+			m_segments.erase(m_segments.begin() + i + 1);
+		}
+		else ++i;
+	}
+
+	return true;
+}
+
+int TextureAtlas::Skyline::getHeight() const
+{
+	int height = 0;
+	for (const auto& s : m_segments)
+		height = std::max(height, s.y);
+	return height;
+}
+
+TextureAtlas::TextureAtlas(int size)
+	:
+m_size(size)
+{}
+
+size_t TextureAtlas::add(Image image)
+{
+	if (alignUp(image.getWidth() + 2 * Gutter) > m_size || alignUp(image.getHeight() + 2 * Gutter) > m_size)
+		throw std::runtime_error("texture is too large for the atlas");
+
+	m_textures.push_back(std::move(image));
+	return m_textures.size() - 1;
+}
+
+void TextureAtlas::build()
+{
+	m_placements.assign(m_textures.size(), Placement());
+	m_pages.clear();
+
+	// tallest textures first
+	std::vector<size_t> order(m_textures.size());
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b)
+	{
+		return m_textures[a].getHeight() > m_textures[b].getHeight();
+	});
+
+	struct Position
+	{
+		int x;
+		int y;
+	};
+	std::vector<Position> positions(m_textures.size());
+	std::vector<Skyline> pages;
+	for(auto t : order)
+	{
+		const auto& tex = m_textures[t];
+		const int width = alignUp(tex.getWidth() + 2 * Gutter);
+		const int height = alignUp(tex.getHeight() + 2 * Gutter);
+
+		auto& p = m_placements[t];
+		for(size_t page = 0; page < pages.size() && p.page < 0; ++page)
+		{
+			if (pages[page].insert(width, height, positions[t].x, positions[t].y))
+				p.page = int(page);
+		}
+		if(p.page < 0)
+		{
+			pages.emplace_back(m_size);
+			pages.back().insert(width, height, positions[t].x, positions[t].y);
+			p.page = int(pages.size() - 1);
+		}
+	}
+
+	// the height of each page is reduced to the used area
+	for(const auto& page : pages)
+	{
+		m_pages.emplace_back(m_size, std::max(page.getHeight(), Alignment));
+		// unused areas must be opaque, otherwise the page of an opaque group would be classified as alpha tested
+		auto& image = m_pages.back();
+		uint8_t* data = image.getData();
+		for (size_t i = 3, end = size_t(image.getWidth()) * size_t(image.getHeight()) * 4; i < end; i += 4)
+			data[i] = 255;
+	}
+
+	for(size_t t = 0; t < m_textures.size(); ++t)
+	{
+		const auto& tex = m_textures[t];
+		auto& p = m_placements[t];
+		auto& page = m_pages[p.page];
+		const int x0 = positions[t].x + Gutter;
+		const int y0 = positions[t].y + Gutter;
+
+		// copy texture + gutter with replicated borders
+		for(int y = -Gutter; y < tex.getHeight() + Gutter; ++y)
+		{
+			const int srcY = std::clamp(y, 0, tex.getHeight() - 1);
+			for(int x = -Gutter; x < tex.getWidth() + Gutter; ++x)
+			{
+				const int srcX = std::clamp(x, 0, tex.getWidth() - 1);
+				std::copy_n(tex.getPixel(srcX, srcY), 4, page.getPixel(x0 + x, y0 + y));
+			}
+		}
+
+		p.scale[0] = float(tex.getWidth()) / float(page.getWidth());
+		p.scale[1] = float(tex.getHeight()) / float(page.getHeight());
+		p.offset[0] = float(x0) / float(page.getWidth());
+		p.offset[1] = float(y0) / float(page.getHeight());
+	}
+
+	m_textures.clear();
+}
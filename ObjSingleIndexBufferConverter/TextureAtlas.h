@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include "Image.h"
+
+// packs small textures into shared atlas images (skyline bottom-left packer).
+// Every texture is surrounded by a gutter of replicated border pixels and aligned so that
+// the first MaxMipmaps mipmaps do not bleed into neighboring textures.
+class TextureAtlas
+{
+public:
+	static constexpr int Gutter = 8;
+	static constexpr int Alignment = 16;
+	// mipmaps that still have at least one gutter pixel
+	static constexpr int MaxMipmaps = 4;
+
+	struct Placement
+	{
+		int page = -1; // index of the atlas image
+		// texcoord transformation (image space: origin top left)
+		float scale[2];
+		float offset[2];
+	};
+
+	explicit TextureAtlas(int size);
+
+	/// \brief adds a texture to the atlas. build() must be called afterwards
+	/// \return index of the texture for getPlacement()
+	size_t add(Image image);
+	/// \brief packs all added textures
+	void build();
+
+	const Placement& getPlacement(size_t texture) const { return m_placements.at(texture); }
+	std::vector<Image>& getPages() { return m_pages; }
+private:
+	class Skyline
+	{
+	public:
+		explicit Skyline(int size);
+		/// \return false if the rectangle does not fit
+		bool insert(int width, int height, int& x, int& y);
+		/// height of the highest segment
+		int getHeight() const;
+	private:
+		struct Segment
+		{
+			int x;
+			int y;
+			int width;
+		};
+		std::vector<Segment> m_segments;
+		int m_size;
+	};
+
+	int m_size;
+	std::vector<Image> m_textures;
+	std::vector<Placement> m_placements;
+	std::vector<Image> m_pages;
+};
@@ -0,0 +1,240 @@
+#include "TextureCache.h"
+#include <fstream>
+#include <map>
+#include <algorithm>
+#include "../json/single_include/nlohmann/json.hpp"
+#include "XXHash64.h"
+#include "Console.h"
+
+using json = nlohmann::json;
+
+static const char* s_alphaNames[] = { "opaque", "mask", "blend" };
+
+static ImageProbe::AlphaMode parseAlphaMode(const std::string& name)
+{
+	for (size_t i = 0; i < std::size(s_alphaNames); ++i)
+		if (name == s_alphaNames[i]) return ImageProbe::AlphaMode(i);
+	throw std::runtime_error("unknown alpha mode " + name);
+}
+
+TextureCache::TextureCache(path manifest)
+	:
+m_manifest(std::move(manifest))
+{
+	std::ifstream file(m_manifest);
+	if (!file.is_open()) return;
+
+	try
+	{
+		json j;
+		file >> j;
+		for(const auto& e : j.at("textures"))
+		{
+			Entry entry;
+			entry.hash = std::stoull(e.at("hash").get<std::string>(), nullptr, 16);
+			entry.size = e.at("size").get<uint64_t>();
+			entry.time = e.at("time").get<int64_t>();
+			entry.settings = e.at("settings").get<std::string>();
+			entry.dst = std::filesystem::u8path(e.at("dst").get<std::string>());
+			entry.alpha = parseAlphaMode(e.at("alpha").get<std::string>());
+			Key key{ e.at("src").get<std::string>(), entry.dst.u8string() };
+			m_entries[std::move(key)] = std::move(entry);
+		}
+	}
+	catch(const std::exception& e)
+	{
+		Console::warning("ignoring texture cache " + m_manifest.string() + ": " + e.what());
+		m_entries.clear();
+	}
+}
+
+std::shared_ptr<TextureCache> TextureCache::get(const path& manifest)
+{
+	static std::mutex mutex;
+	static std::map<path, std::weak_ptr<TextureCache>> caches;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& weak = caches[std::filesystem::absolute(manifest)];
+	auto cache = weak.lock();
+	if(!cache)
+	{
+		cache = std::make_shared<TextureCache>(manifest);
+		weak = cache;
+	}
+	return cache;
+}
+
+std::optional<TextureCache::Entry> TextureCache::find(const path& src, const path& dst, const std::string& settings)
+{
+	return find({ src.u8string(), dst.u8string() }, { src }, settings);
+}
+
+std::optional<TextureCache::Entry> TextureCache::find(const std::array<path, 4>& channels, const path& dst, const std::string& settings)
+{
+	return find({ getPackedKey(channels), dst.u8string() }, getPackedSources(channels), settings);
+}
+
+void TextureCache::claim(const path& dst, const std::string& settings, const std::shared_ptr<const void>& owner)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto& claim = m_claims[dst];
+	const auto current = claim.owner.lock();
+	// the previous owner was destroyed => the destination is free again
+	if(!current)
+	{
+		claim = { owner, settings };
+		return;
+	}
+	if (current != owner && claim.settings != settings)
+		throw std::runtime_error("conflicting texture settings for " + dst.string() + " (" + claim.settings + " and " + settings + "). Use different output directories");
+}
+
+std::optional<TextureCache::Entry> TextureCache::find(const Key& key, const std::vector<path>& sources, const std::string& settings)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(key);
+	if (it == m_entries.end()) return {};
+	auto entry = it->second;
+	lock.unlock();
+
+	if (entry.settings != settings) return {};
+
+	uint64_t size = 0;
+	for(const auto& src : sources)
+	{
+		std::error_code ec;
+		size += std::filesystem::file_size(src, ec);
+		if (ec) return {};
+	}
+	if (!std::filesystem::exists(entry.dst)) return {};
+
+	const auto time = getWriteTime(sources);
+	if (size == entry.size && time == entry.time)
+		return entry;
+
+	// file was touched => compare content
+	if (size != entry.size || hashSources(sources) != entry.hash)
+		return {};
+
+	entry.time = time;
+	lock.lock();
+	m_entries[key] = entry;
+	m_modified = true;
+	return entry;
+}
+
+uint64_t TextureCache::getContentHash(const path& src)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	// any destination of the source has the hash
+	const auto srcKey = src.u8string();
+	auto it = m_entries.lower_bound({ srcKey, std::string() });
+	if(it != m_entries.end() && it->first.first == srcKey)
+	{
+		auto entry = it->second;
+		lock.unlock();
+		if (std::filesystem::file_size(src) == entry.size && getWriteTime(src) == entry.time)
+			return entry.hash;
+	}
+	else lock.unlock();
+
+	return XXHash64::hashFile(src);
+}
+
+void TextureCache::insert(const path& src, Entry entry)
+{
+	Key key{ src.u8string(), entry.dst.u8string() };
+	insert(key, { src }, std::move(entry));
+}
+
+void TextureCache::insert(const std::array<path, 4>& channels, Entry entry)
+{
+	Key key{ getPackedKey(channels), entry.dst.u8string() };
+	insert(key, getPackedSources(channels), std::move(entry));
+}
+
+void TextureCache::insert(const Key& key, const std::vector<path>& sources, Entry entry)
+{
+	entry.size = 0;
+	for (const auto& src : sources)
+		entry.size += std::filesystem::file_size(src);
+	entry.time = getWriteTime(sources);
+	entry.hash = hashSources(sources);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries[key] = std::move(entry);
+	m_modified = true;
+}
+
+void TextureCache::save()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_modified) return;
+
+	json textures = json::array();
+	for(const auto& [key, e] : m_entries)
+	{
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(e.hash));
+		textures.push_back({
+			{"src", key.first},
+			{"hash", hash},
+			{"size", e.size},
+			{"time", e.time},
+			{"settings", e.settings},
+			{"dst", e.dst.u8string()},
+			{"alpha", s_alphaNames[size_t(e.alpha)]}
+		});
+	}
+
+	std::filesystem::create_directories(m_manifest.parent_path());
+	std::ofstream file(m_manifest);
+	if (!file.is_open())
+		throw std::runtime_error("could not write texture cache " + m_manifest.string());
+	file << json{ {"textures", textures} }.dump(1, '\t');
+	m_modified = false;
+}
+
+int64_t TextureCache::getWriteTime(const path& file)
+{
+	return int64_t(std::filesystem::last_write_time(file).time_since_epoch().count());
+}
+
+int64_t TextureCache::getWriteTime(const std::vector<path>& sources)
+{
+	int64_t time = 0;
+	for (const auto& src : sources)
+		time = std::max(time, getWriteTime(src));
+	return time;
+}
+
+uint64_t TextureCache::hashSources(const std::vector<path>& sources)
+{
+	// single sources keep the plain file hash (compatible with getContentHash)
+	if (sources.size() == 1)
+		return XXHash64::hashFile(sources.front());
+
+	std::vector<uint64_t> hashes;
+	hashes.reserve(sources.size());
+	for (const auto& src : sources)
+		hashes.push_back(XXHash64::hashFile(src));
+	return XXHash64::hash(hashes.data(), hashes.size() * sizeof(uint64_t));
+}
+
+std::string TextureCache::getPackedKey(const std::array<path, 4>& channels)
+{
+	// the layout is part of the key: the same maps in different channels produce a different texture
+	static const char slots[] = { 'r', 'g', 'b', 'a' };
+	std::string key = "packed";
+	for (size_t i = 0; i < channels.size(); ++i)
+		key += std::string("|") + slots[i] + "=" + channels[i].u8string();
+	return key;
+}
+
+std::vector<TextureCache::path> TextureCache::getPackedSources(const std::array<path, 4>& channels)
+{
+	std::vector<path> sources;
+	for (const auto& c : channels)
+		if (!c.empty()) sources.push_back(c);
+	return sources;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <memory>
+#include <array>
+#include <vector>
+#include "ImageProbe.h"
+
+// persistent manifest of converted textures. Maps source files + export settings to the exported file.
+// Is stored as json in the destination directory and can be used from multiple threads.
+class TextureCache
+{
+public:
+	using path = std::filesystem::path;
+
+	struct Entry
+	{
+		uint64_t hash = 0; // content hash of the source
+		uint64_t size = 0; // source file size
+		int64_t time = 0; // source last write time
+		std::string settings; // export settings key
+		path dst;
+		ImageProbe::AlphaMode alpha = ImageProbe::AlphaMode::Opaque;
+	};
+
+	/// \brief loads the manifest if it exists
+	explicit TextureCache(path manifest);
+
+	/// \brief returns the cache for the manifest. Converters that write into the same directory share one instance
+	static std::shared_ptr<TextureCache> get(const path& manifest);
+
+	/// \brief returns the cached entry if the source did not change since it was exported to dst.
+	/// Only size and write time are checked. If those changed the content hash is compared.
+	std::optional<Entry> find(const path& src, const path& dst, const std::string& settings);
+	/// \brief returns the cached entry of a packed texture if none of its channel sources changed.
+	/// The channel layout is part of the key (empty paths for unused channels)
+	std::optional<Entry> find(const std::array<path, 4>& channels, const path& dst, const std::string& settings);
+	/// \brief returns the content hash of the source. The file is only read if it changed since it was cached
+	uint64_t getContentHash(const path& src);
+	/// \brief adds or replaces the entry for the source. Size, time and hash are computed from the source
+	void insert(const path& src, Entry entry);
+	/// \brief adds or replaces the entry for a packed texture. Size, time and hash are combined from all channel sources
+	void insert(const std::array<path, 4>& channels, Entry entry);
+	/// \brief reserves the destination for the export settings during this process.
+	/// Throws if another converter (batch job) already exports to dst with different settings
+	/// \param owner token of the converter that exports the file. The claim ends when the owner is destroyed
+	void claim(const path& dst, const std::string& settings, const std::shared_ptr<const void>& owner);
+	/// \brief writes the manifest if it was modified
+	void save();
+private:
+	// (source or packed channel layout, destination)
+	using Key = std::pair<std::string, std::string>;
+
+	std::optional<Entry> find(const Key& key, const std::vector<path>& sources, const std::string& settings);
+	void insert(const Key& key, const std::vector<path>& sources, Entry entry);
+
+	static int64_t getWriteTime(const path& file);
+	// latest write time of all sources
+	static int64_t getWriteTime(const std::vector<path>& sources);
+	static uint64_t hashSources(const std::vector<path>& sources);
+	static std::string getPackedKey(const std::array<path, 4>& channels);
+	static std::vector<path> getPackedSources(const std::array<path, 4>& channels);
+
+	path m_manifest;
+	std::map<Key, Entry> m_entries;
+	struct Claim
+	{
+		std::weak_ptr<const void> owner;
+		std::string settings;
+	};
+	// destination => converter that exports it
+	std::map<path, Claim> m_claims;
+	std::mutex m_mutex;
+	bool m_modified = false;
+};
@@ -1,57 +1,569 @@
 #include "TextureConverter.h"
 #include <iostream>
+#include <execution>
+#include <mutex>
+#include <algorithm>
 #include "../image/ImageFramework.h"
+#include "DdsWriter.h"
+#include "Ktx2Writer.h"
+#include "Console.h"
+#include "ImageProbe.h"
+#include "NormalMap.h"
+#include "Profiler.h"
 
 static ImageFramework::Model s_image("../image/ImageConsole.exe");
+static constexpr int s_exportQuality = 90;
+// the image console is shared by all converters
+static std::mutex s_imageMutex;
 
-TextureConverter::TextureConverter(path srcPath, path dstPath, bool writeFiles)
+TextureConverter::TextureConverter(path srcPath, path dstPath, Settings settings)
 	:
 m_srcRoot(srcPath),
 m_dstRoot(dstPath),
-m_writeFiles(writeFiles)
+m_settings(settings),
+m_cache(TextureCache::get(getCacheManifest(m_dstRoot)))
 {
+	std::lock_guard<std::mutex> lock(s_imageMutex);
 	//s_image.SetExportQuality(20);
-	s_image.SetExportQuality(90);
+	s_image.SetExportQuality(s_exportQuality);
 }
 
-TextureConverter::path TextureConverter::convertTexture(const path& filename)
+TextureConverter::path TextureConverter::convertTexture(const path& filename, Type type, Limits limits)
 {
 	if (filename.empty()) return "";
 
 	auto srcPath = m_srcRoot / filename;
-	auto dstPath = (m_dstRoot / filename).replace_extension(".dds");
+	auto dstPath = (m_dstRoot / filename).replace_extension(getExtension());
 
-	auto it = m_convertedMap.find(srcPath);
+	auto it = m_convertedMap.find({ srcPath, type });
 	if(it != m_convertedMap.end())
 	{
+		// not converted yet => the limits can still be changed
+		for (auto& job : m_pending)
+			if (job.src == srcPath && job.type == type) relaxLimits(job.limits, limits);
 		return it->second;
 	}
 
+	// the same file might also be used with another type (e.g. as color and normal map) => different encoding
+	const auto isUsed = [this](const path& dst)
+	{
+		return std::any_of(m_convertedMap.begin(), m_convertedMap.end(), [&dst](const auto& p) { return p.second == dst; });
+	};
+	if(isUsed(dstPath))
+	{
+		const auto stem = dstPath.stem().string() + (type == Type::Normal ? "_normal" : "_color");
+		dstPath.replace_filename(stem + getExtension());
+		for (int i = 1; isUsed(dstPath); ++i)
+			dstPath.replace_filename(stem + std::to_string(i) + getExtension());
+	}
+
 	// add new entry
-	m_convertedMap[srcPath] = dstPath;
+	m_convertedMap[{ srcPath, type }] = dstPath;
+	m_pending.push_back({ srcPath, dstPath, type, nullptr, 0, limits });
+
+	return dstPath;
+}
+
+TextureConverter::path TextureConverter::convertBumpMap(const path& filename, float strength, Limits limits)
+{
+	if (filename.empty()) return "";
 
-	// assure that the directory is available
-	std::filesystem::create_directories(dstPath.parent_path());
+	auto srcPath = m_srcRoot / filename;
+	auto dstPath = m_dstRoot / filename;
+	dstPath.replace_filename(dstPath.stem().string() + "_normal" + getExtension());
+
+	auto it = m_convertedMap.find({ srcPath, Type::Bump });
+	if(it != m_convertedMap.end())
+	{
+		for (auto& job : m_pending)
+			if (job.src == srcPath && job.type == Type::Bump) relaxLimits(job.limits, limits);
+		return it->second;
+	}
+
+	m_convertedMap[{ srcPath, Type::Bump }] = dstPath;
+	m_pending.push_back({ srcPath, dstPath, Type::Bump, nullptr, 0, limits, strength });
+
+	return dstPath;
+}
+
+TextureConverter::path TextureConverter::convertPacked(const std::array<path, 4>& channels, Limits limits)
+{
+	std::array<path, 4> srcPaths;
+	path dstPath;
+	for(size_t i = 0; i < channels.size(); ++i)
+	{
+		if (channels[i].empty()) continue;
+		srcPaths[i] = m_srcRoot / channels[i];
+		// named after the first channel
+		if(dstPath.empty())
+		{
+			dstPath = m_dstRoot / channels[i];
+			dstPath.replace_filename(dstPath.stem().string() + "_packed" + getExtension());
+		}
+	}
+	if (dstPath.empty()) return "";
+
+	auto it = m_packedMap.find(srcPaths);
+	if(it != m_packedMap.end())
+	{
+		for (auto& job : m_pending)
+			if (job.channels == srcPaths) relaxLimits(job.limits, limits);
+		return it->second;
+	}
+
+	// different channel combinations might start with the same file
+	const auto stem = dstPath.stem().string();
+	for(int i = 1; std::any_of(m_packedMap.begin(), m_packedMap.end(), [&dstPath](const auto& p) { return p.second == dstPath; }); ++i)
+		dstPath.replace_filename(stem + std::to_string(i) + getExtension());
+
+	m_packedMap[srcPaths] = dstPath;
+	Job job{ path(), dstPath, Type::Data, nullptr, 0, limits };
+	job.channels = srcPaths;
+	m_pending.push_back(std::move(job));
+
+	return dstPath;
+}
+
+TextureConverter::path TextureConverter::convertImage(Image image, const path& filename, Type type, int maxMipmaps)
+{
+	auto dstPath = (m_dstRoot / filename).replace_extension(getExtension());
+	m_pending.push_back({ path(), dstPath, type, std::make_shared<const Image>(std::move(image)), maxMipmaps });
+	return dstPath;
+}
+
+void TextureConverter::convertPending()
+{
+	const auto duplicates = removeDuplicates();
+
+	// batch jobs that share the output directory must agree on the texture settings
+	for (const auto& job : m_pending)
+		m_cache->claim(job.dst, getSettingsKey(job), m_claimOwner);
+
+	// skip all textures that did not change since the last export
+	std::vector<Job> jobs;
+	for(const auto& job : m_pending)
+	{
+		if (job.src.empty() && !job.isPacked()) // generated
+			jobs.push_back(job);
+		else if(auto entry = findCached(job))
+		{
+			setAlphaMode(job.dst, entry->alpha);
+		}
+		else jobs.push_back(job);
+	}
+	if (jobs.size() != m_pending.size())
+		Console::info(std::to_string(m_pending.size() - jobs.size()) + " textures are up to date");
+	m_pending.clear();
+
+	// assure that the directories are available
+	for (const auto& job : jobs)
+		std::filesystem::create_directories(job.dst.parent_path());
+
+	// the image console is only used for formats that are not supported in-process
+	std::vector<Job> fallback;
+	{
+		std::mutex mutex;
+		size_t numConverted = 0;
+		std::for_each(std::execution::par, jobs.begin(), jobs.end(), [&](const Job& job)
+		{
+			Profiler::Scope profile("texture");
+			auto alpha = ImageProbe::AlphaMode::Opaque;
+			bool converted = false;
+			try
+			{
+				auto lock = lockDestination(job.dst);
+				// might have been converted by another converter in the meantime
+				std::optional<TextureCache::Entry> entry;
+				if (!job.src.empty() || job.isPacked())
+					entry = findCached(job);
+				if(entry)
+				{
+					alpha = entry->alpha;
+					converted = true;
+				}
+				else
+					converted = convertInProcess(job, alpha);
+				if (!entry && converted && m_settings.writeFiles && (!job.src.empty() || job.isPacked()))
+					insertCached(job, alpha);
+			}
+			catch(const std::exception& e)
+			{
+				Console::warning(e.what());
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!converted && (job.limits.maxSize || job.limits.maxMipSize))
+			{
+				Console::warning("could not downscale " + job.src.string() + ", exporting with full resolution");
+				fallback.push_back(job);
+				fallback.back().limits = Limits();
+			}
+			else if (!converted)
+				fallback.push_back(job);
+			else
+				setAlphaMode(job.dst, alpha);
+			Console::progress("textures", ++numConverted, jobs.size());
+		});
+	}
+
+	// the alpha channel can usually be determined without the image console
+	std::vector<std::optional<ImageProbe::AlphaMode>> alpha(fallback.size());
+	std::transform(std::execution::par, fallback.begin(), fallback.end(), alpha.begin(), [](const Job& job)
+	{
+		return detectAlpha(job.src);
+	});
+
+	// the image console is a single process => sequential
+	for (size_t i = 0; i < fallback.size(); ++i)
+		convertWithImageConsole(fallback[i], alpha[i]);
+
+	m_cache->save();
+
+	if(!duplicates.empty())
+	{
+		uint64_t bytesSaved = 0;
+		for(const auto& dst : duplicates)
+		{
+			std::error_code ec;
+			const auto size = std::filesystem::file_size(dst, ec);
+			if (!ec) bytesSaved += size;
+		}
+		m_numDuplicates += duplicates.size();
+		m_duplicateBytesSaved += bytesSaved;
+		Console::info("skipped " + std::to_string(duplicates.size()) + " duplicate textures (" + std::to_string(bytesSaved / 1024) + " KB)");
+	}
+}
+
+std::vector<TextureConverter::path> TextureConverter::removeDuplicates()
+{
+	std::vector<std::optional<uint64_t>> hashes(m_pending.size());
+	std::transform(std::execution::par, m_pending.begin(), m_pending.end(), hashes.begin(), [this](const Job& job) -> std::optional<uint64_t>
+	{
+		if (job.src.empty()) return {};
+		try
+		{
+			return m_cache->getContentHash(job.src);
+		}
+		catch (const std::exception&)
+		{
+			return {}; // missing files are reported by the conversion
+		}
+	});
+
+	std::vector<Job> unique;
+	std::vector<path> duplicates;
+	// destination path => index in unique
+	std::map<path, size_t> uniqueIndices;
+	for(size_t i = 0; i < m_pending.size(); ++i)
+	{
+		auto& job = m_pending[i];
+		if(job.src.empty() || !hashes[i].has_value())
+		{
+			unique.push_back(std::move(job));
+			continue;
+		}
+
+		const auto [it, inserted] = m_contentMap.emplace(std::make_pair(*hashes[i], job.type), job.dst);
+		if(inserted)
+		{
+			uniqueIndices[job.dst] = unique.size();
+			unique.push_back(std::move(job));
+			continue;
+		}
+
+		// the used texture must satisfy both requests
+		const auto used = uniqueIndices.find(it->second);
+		if (used != uniqueIndices.end())
+			relaxLimits(unique[used->second].limits, job.limits);
+
+		// identical to a previous texture => redirect to its output
+		m_convertedMap[{ job.src, job.type }] = it->second;
+		m_duplicateMap[job.dst] = it->second;
+		duplicates.push_back(it->second);
+	}
+
+	m_pending = std::move(unique);
+	return duplicates;
+}
+
+std::optional<TextureCache::Entry> TextureConverter::findCached(const Job& job) const
+{
+	if (job.isPacked())
+		return m_cache->find(job.channels, job.dst, getSettingsKey(job));
+	return m_cache->find(job.src, job.dst, getSettingsKey(job));
+}
+
+void TextureConverter::insertCached(const Job& job, ImageProbe::AlphaMode alpha) const
+{
+	TextureCache::Entry entry{ 0, 0, 0, getSettingsKey(job), job.dst, alpha };
+	if (job.isPacked())
+		m_cache->insert(job.channels, std::move(entry));
+	else
+		m_cache->insert(job.src, std::move(entry));
+}
+
+std::string TextureConverter::getSettingsKey(const Job& job) const
+{
+	std::string key = m_settings.compress ?
+		"bc_" + std::to_string(int(m_settings.quality)) :
+		"rgba8";
+	if (job.type == Type::Bump)
+		key += "_bump" + std::to_string(job.bumpStrength);
+	else if (job.type == Type::Data)
+		key += "_data";
+	else
+		key += job.type == Type::Normal ? "_normal" : "_color";
+	if (m_settings.container == Container::Ktx2)
+		key += m_settings.supercompress ? "_ktx2_zlib" : "_ktx2";
+	if (job.limits.maxSize)
+		key += "_max" + std::to_string(job.limits.maxSize);
+	if (job.limits.maxMipSize)
+		key += "_mip" + std::to_string(job.limits.maxMipSize);
+	return key;
+}
+
+void TextureConverter::convertWithImageConsole(const Job& job, std::optional<ImageProbe::AlphaMode> alpha)
+{
+	if(!m_settings.writeFiles && alpha.has_value())
+	{
+		// nothing to do for the image console
+		setAlphaMode(job.dst, *alpha);
+		return;
+	}
+
+	if(job.type == Type::Bump)
+	{
+		Console::warning("could not convert bump map " + job.src.string());
+		return;
+	}
+	// packing is only done in-process (the error was already reported)
+	if (job.isPacked())
+		return;
+	if(m_settings.container == Container::Ktx2)
+	{
+		Console::warning("could not convert " + job.src.string() + " to ktx2");
+		if (alpha.has_value())
+			setAlphaMode(job.dst, *alpha);
+		return;
+	}
+
+	std::lock_guard<std::mutex> imageLock(s_imageMutex);
+	auto lock = lockDestination(job.dst);
 
 	// open file
 	s_image.ClearImages();
-	s_image.OpenImage(srcPath.string());
-	const char* dstFormat = "RGBA8_SRGB";
-	if(s_image.IsAlpha())
+	s_image.OpenImage(job.src.string());
+	const char* dstFormat = job.type == Type::Color ? "RGBA8_SRGB" : "RGBA8_UNORM";
+	// no histogram available => assume blending
+	if (!alpha.has_value())
+		alpha = s_image.IsAlpha() ? ImageProbe::AlphaMode::Blend : ImageProbe::AlphaMode::Opaque;
+	setAlphaMode(job.dst, *alpha);
+
+	if(m_settings.writeFiles)
 	{
-		m_alphaMap.insert(dstPath);
+		s_image.GenMipmaps();
+		s_image.Export(job.dst.string(), dstFormat);
+		s_image.Sync();
+		m_cache->insert(job.src, { 0, 0, 0, getSettingsKey(job), job.dst, *alpha });
 	}
+}
 
-	if(!std::filesystem::exists(dstPath))
+bool TextureConverter::convertInProcess(const Job& job, ImageProbe::AlphaMode& alpha) const
+{
+	Image image;
+	if(job.image)
 	{
-		s_image.GenMipmaps();
-		s_image.Export(dstPath.string(), dstFormat);
+		image = *job.image;
+		alpha = ImageProbe::classifyAlpha(image);
+	}
+	else if(job.isPacked())
+	{
+		alpha = ImageProbe::AlphaMode::Opaque;
+		if (!m_settings.writeFiles)
+			return true;
+		image = packChannels(job);
+		alpha = ImageProbe::classifyAlpha(image);
+	}
+	else
+	{
+		try
+		{
+			image = Image::load(job.src);
+		}
+		catch (const std::exception&)
+		{
+			return false;
+		}
+		// the alpha channel of normal maps is not used
+		alpha = ImageProbe::Alpha::None == ImageProbe::probeAlpha(job.src) || isNormalMap(job.type) ?
+			ImageProbe::AlphaMode::Opaque : ImageProbe::classifyAlpha(image);
 	}
 
-	return dstPath;
+	if (!m_settings.writeFiles)
+		return true;
+
+	if (job.type == Type::Bump)
+		image = NormalMap::fromHeight(image, job.bumpStrength);
+	else if (job.type == Type::Normal)
+		NormalMap::normalize(image);
+
+	// choose format based on the alpha analysis
+	const bool srgb = job.type == Type::Color;
+	applyLimits(job, image);
+	auto format = BlockCompression::Format::BC1;
+	if (isNormalMap(job.type))
+		format = BlockCompression::Format::BC5;
+	else if (alpha != ImageProbe::AlphaMode::Opaque)
+		format = m_settings.quality == BlockCompression::Quality::High ? BlockCompression::Format::BC7 : BlockCompression::Format::BC3;
+	// normal maps are always compressed into two channels (z is reconstructed)
+	const bool compress = m_settings.compress || isNormalMap(job.type);
+	auto dxgiFormat = DdsWriter::getDxgiFormat(format, srgb);
+	if (!compress)
+		dxgiFormat = srgb ? DdsWriter::R8G8B8A8_UNORM_SRGB : DdsWriter::R8G8B8A8_UNORM;
+
+	int numMipmaps = Image::computeMipmapCount(image.getWidth(), image.getHeight());
+	if (job.maxMipmaps)
+		numMipmaps = std::min(numMipmaps, job.maxMipmaps);
+	std::unique_ptr<TextureWriter> writer;
+	if (m_settings.container == Container::Ktx2)
+		writer = std::make_unique<Ktx2Writer>(job.dst, dxgiFormat, image.getWidth(), image.getHeight(), numMipmaps,
+			m_settings.supercompress ? Ktx2Writer::Zlib : Ktx2Writer::None);
+	else
+		writer = std::make_unique<DdsWriter>(job.dst, dxgiFormat, image.getWidth(), image.getHeight(), numMipmaps);
+	// only the current and the next mipmap are kept in memory
+	for(int mip = 0; mip < numMipmaps; ++mip)
+	{
+		if (mip != 0)
+			image = isNormalMap(job.type) ? NormalMap::generateMipmap(image) : image.generateMipmap(srgb);
+
+		if(!compress)
+		{
+			writer->writeMipmap(image.getData(), size_t(image.getWidth()) * size_t(image.getHeight()) * 4);
+			continue;
+		}
+
+		// blocks are written directly into the output file (if supported by the writer)
+		const auto size = BlockCompression::getCompressedSize(format, image.getWidth(), image.getHeight());
+		BlockCompression::compress(image, format, m_settings.quality, writer->beginMipmap(size));
+		writer->endMipmap();
+	}
+	writer->finish();
+
+	return true;
+}
+
+std::unique_lock<std::mutex> TextureConverter::lockDestination(const path& dst)
+{
+	static std::mutex mapMutex;
+	static std::map<path, std::mutex> mutexes;
+
+	std::unique_lock<std::mutex> mapLock(mapMutex);
+	auto& mutex = mutexes[dst];
+	mapLock.unlock();
+	return std::unique_lock<std::mutex>(mutex);
+}
+
+void TextureConverter::relaxLimits(Limits& dst, const Limits& src)
+{
+	auto relax = [](int a, int b)
+	{
+		if (a == 0 || b == 0) return 0;
+		return std::max(a, b);
+	};
+	dst.maxSize = relax(dst.maxSize, src.maxSize);
+	dst.maxMipSize = relax(dst.maxMipSize, src.maxMipSize);
+}
+
+void TextureConverter::applyLimits(const Job& job, Image& image)
+{
+	const bool srgb = job.type == Type::Color;
+	const int maxSize = job.limits.maxSize;
+	if(maxSize && std::max(image.getWidth(), image.getHeight()) > maxSize)
+	{
+		const float scale = float(maxSize) / float(std::max(image.getWidth(), image.getHeight()));
+		image = image.resize(
+			std::max(int(float(image.getWidth()) * scale + 0.5f), 1),
+			std::max(int(float(image.getHeight()) * scale + 0.5f), 1),
+			srgb);
+		if (isNormalMap(job.type))
+			NormalMap::normalize(image);
+	}
+
+	// the smaller mipmaps are exactly the same as for the full chain
+	const int maxMipSize = job.limits.maxMipSize;
+	while(maxMipSize && std::max(image.getWidth(), image.getHeight()) > maxMipSize)
+		image = isNormalMap(job.type) ? NormalMap::generateMipmap(image) : image.generateMipmap(srgb);
+}
+
+Image TextureConverter::packChannels(const Job& job)
+{
+	std::array<Image, 4> sources;
+	int width = 1;
+	int height = 1;
+	for(size_t i = 0; i < sources.size(); ++i)
+	{
+		if (job.channels[i].empty()) continue;
+		sources[i] = Image::load(job.channels[i]);
+		width = std::max(width, sources[i].getWidth());
+		height = std::max(height, sources[i].getHeight());
+	}
+
+	Image res(width, height);
+	std::fill(res.getData(), res.getData() + size_t(width) * size_t(height) * 4, uint8_t(255));
+	for(size_t i = 0; i < sources.size(); ++i)
+	{
+		if (sources[i].empty()) continue;
+		if (sources[i].getWidth() != width || sources[i].getHeight() != height)
+			sources[i] = sources[i].resize(width, height, false);
+
+		for (int y = 0; y < height; ++y)
+		{
+			const uint8_t* src = sources[i].getPixel(0, y);
+			uint8_t* dst = res.getPixel(0, y) + i;
+			for (int x = 0; x < width; ++x)
+				dst[x * 4] = src[x * 4];
+		}
+	}
+	return res;
 }
 
-bool TextureConverter::hasAlpha(const path& dstFilePath)
+std::optional<ImageProbe::AlphaMode> TextureConverter::detectAlpha(const path& src)
 {
-	return m_alphaMap.find(dstFilePath) != m_alphaMap.end();
-}
\ No newline at end of file
+	if (ImageProbe::probeAlpha(src) == ImageProbe::Alpha::None)
+		return ImageProbe::AlphaMode::Opaque;
+
+	// alpha channel is present or the format is unknown => check how the alpha is used
+	try
+	{
+		return ImageProbe::classifyAlpha(Image::load(src));
+	}
+	catch (const std::exception&)
+	{
+		return {};
+	}
+}
+
+void TextureConverter::setAlphaMode(const path& dst, ImageProbe::AlphaMode mode)
+{
+	if (mode != ImageProbe::AlphaMode::Opaque)
+		m_alphaMap[dst] = mode;
+}
+
+TextureConverter::path TextureConverter::resolveDuplicate(const path& dstFilePath) const
+{
+	auto it = m_duplicateMap.find(dstFilePath);
+	if (it == m_duplicateMap.end()) return dstFilePath;
+	return it->second;
+}
+
+ImageProbe::AlphaMode TextureConverter::getAlphaMode(const path& dstFilePath) const
+{
+	auto it = m_alphaMap.find(resolveDuplicate(dstFilePath));
+	if (it == m_alphaMap.end()) return ImageProbe::AlphaMode::Opaque;
+	return it->second;
+}
+
+bool TextureConverter::hasAlpha(const path& dstFilePath) const
+{
+	return getAlphaMode(dstFilePath) != ImageProbe::AlphaMode::Opaque;
+}
@@ -2,29 +2,170 @@
 #include <string>
 #include <filesystem>
 #include <map>
-#include <set>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <array>
+#include <mutex>
+#include "BlockCompression.h"
+#include "TextureCache.h"
+#include "ImageProbe.h"
 
 
-// converts all files from png, jpg... to dds format with appropriate mipmaps
+// converts all files from png, jpg... to dds (or ktx2) format with appropriate mipmaps
 class TextureConverter
 {
 public:
 	using path = std::filesystem::path;
 
-	/// \param writeFiles indicates if the textures should be converted and written to the destination
-	TextureConverter(path srcPath, path dstPath, bool writeFiles);
+	enum class Type
+	{
+		Color, // srgb color data
+		Normal, // tangent space normal map (linear)
+		Bump, // height map that is converted into a tangent space normal map
+		Data // linear non-color data (e.g. packed material channels)
+	};
+
+	enum class Container
+	{
+		Dds,
+		Ktx2 // always written in-process
+	};
+
+	struct Settings
+	{
+		// indicates if the textures should be converted and written to the destination
+		bool writeFiles = true;
+		// use the in-process block compression instead of uncompressed RGBA8
+		bool compress = false;
+		BlockCompression::Quality quality = BlockCompression::Quality::Normal;
+		Container container = Container::Dds;
+		// zlib supercompression of the ktx2 mipmaps
+		bool supercompress = true;
+	};
+
+	// resolution limits of a single texture (longest side in pixels, 0 = unlimited)
+	struct Limits
+	{
+		// larger textures are downscaled with a lanczos filter before the mipmap generation
+		int maxSize = 0;
+		// top mipmaps that are larger are skipped (e.g. insufficient uv density in the mesh)
+		int maxMipSize = 0;
+	};
+
+	TextureConverter(path srcPath, path dstPath, Settings settings);
 	TextureConverter() = default;
 
-	/// \param expectSrgb expects png, jpg to be srgb when loading
-	path convertTexture(const path& filename);
+	/// \brief registers a texture for conversion. The conversion itself is done in convertPending()
+	/// \param limits if the texture is requested multiple times, the least restrictive limits are used
+	/// \return destination path of the converted texture. Gets a type suffix if the file is also used with another type
+	path convertTexture(const path& filename, Type type, Limits limits);
+	path convertTexture(const path& filename, Type type = Type::Color) { return convertTexture(filename, type, Limits()); }
+
+	/// \brief registers a height map that will be converted into a tangent space normal map
+	/// \param strength scales the height differences (bump multiplier)
+	/// \return destination path of the normal map
+	path convertBumpMap(const path& filename, float strength, Limits limits);
+
+	/// \brief registers a texture that combines the red channels of up to four scalar maps into the rgba channels.
+	/// All maps are resampled to the largest resolution. Missing channels are set to 1.0
+	/// \param channels source filenames for r, g, b, a (empty for unused channels)
+	/// \return destination path of the packed texture
+	path convertPacked(const std::array<path, 4>& channels, Limits limits);
+
+	/// \brief registers an image that was generated in-process (e.g. texture atlas) for conversion.
+	/// Generated images are always written in-process and are not cached
+	/// \param filename destination filename relative to the destination directory
+	/// \param maxMipmaps limits the number of mipmaps (0 = full chain)
+	/// \return destination path of the converted texture
+	path convertImage(Image image, const path& filename, Type type, int maxMipmaps = 0);
+
+	/// \brief converts all textures that were registered since the last call.
+	/// In-process conversions run in parallel
+	void convertPending();
 
-	/// \params indicates if an already converted image had an alpha channel
-	bool hasAlpha(const path& dstFilePath);
+	/// \brief textures with identical content are only converted once.
+	/// \return destination path that is actually used for the texture returned by convertTexture()
+	path resolveDuplicate(const path& dstFilePath) const;
+
+	/// number of textures that were identical to another texture
+	size_t getNumDuplicates() const { return m_numDuplicates; }
+	/// size in bytes of the output files that did not need to be written because of duplicates
+	uint64_t getDuplicateBytesSaved() const { return m_duplicateBytesSaved; }
+
+	/// \brief classification of the alpha channel of an already converted image
+	ImageProbe::AlphaMode getAlphaMode(const path& dstFilePath) const;
+	/// \params indicates if an already converted image had an alpha channel that is not fully opaque
+	bool hasAlpha(const path& dstFilePath) const;
+
+	/// \brief texture cache manifest of a destination directory
+	static path getCacheManifest(const path& dstPath) { return dstPath / "textures.cache.json"; }
 private:
+	struct Job
+	{
+		path src;
+		path dst;
+		Type type;
+		// generated image (src is empty)
+		std::shared_ptr<const Image> image;
+		int maxMipmaps = 0;
+		Limits limits;
+		// only for Type::Bump
+		float bumpStrength = 1.0f;
+		// source files of packed textures (src is empty)
+		std::array<path, 4> channels;
+
+		bool isPacked() const { return !channels[0].empty() || !channels[1].empty() || !channels[2].empty() || !channels[3].empty(); }
+	};
+
+	/// file extension of the converted textures
+	const char* getExtension() const { return m_settings.container == Container::Ktx2 ? ".ktx2" : ".dds"; }
+	/// normal maps and bump maps are both exported as normal maps
+	static bool isNormalMap(Type type) { return type == Type::Normal || type == Type::Bump; }
+	/// \brief converters in different threads (batch mode) must not write the same file at the same time
+	static std::unique_lock<std::mutex> lockDestination(const path& dst);
+	/// \brief loads the channel sources of the job and combines them. Throws if a source could not be loaded
+	static Image packChannels(const Job& job);
+
+	/// \brief combines the limits of two requests of the same texture
+	static void relaxLimits(Limits& dst, const Limits& src);
+	/// \brief downscales the image according to the resolution limits of the job
+	static void applyLimits(const Job& job, Image& image);
+
+	/// \brief removes pending jobs whose source content was already seen
+	/// \return destination paths that are used instead of the removed jobs
+	std::vector<path> removeDuplicates();
+	/// key that identifies the export settings of the job in the texture cache
+	std::string getSettingsKey(const Job& job) const;
+	/// \brief looks up the job in the texture cache. Packed jobs are keyed by their channel sources and layout
+	std::optional<TextureCache::Entry> findCached(const Job& job) const;
+	void insertCached(const Job& job, ImageProbe::AlphaMode alpha) const;
+	/// \param alpha result of detectAlpha()
+	void convertWithImageConsole(const Job& job, std::optional<ImageProbe::AlphaMode> alpha);
+	/// \return false if the image format is not supported by the in-process loader
+	bool convertInProcess(const Job& job, ImageProbe::AlphaMode& alpha) const;
+	/// \brief probes the header and only decodes the image if it has an alpha channel
+	/// \return empty if the image could not be inspected in-process
+	static std::optional<ImageProbe::AlphaMode> detectAlpha(const path& src);
+	void setAlphaMode(const path& dst, ImageProbe::AlphaMode mode);
+
 	path m_srcRoot;
 	path m_dstRoot;
-	std::map<path, path> m_convertedMap;
-	// only contains textures (destination path) that have a native alpha channel
-	std::set<path> m_alphaMap;
-	bool m_writeFiles;
-};
\ No newline at end of file
+	// (source path, type) => destination path
+	std::map<std::pair<path, Type>, path> m_convertedMap;
+	// channel sources => destination path
+	std::map<std::array<path, 4>, path> m_packedMap;
+	// (content hash, type) => destination path
+	std::map<std::pair<uint64_t, Type>, path> m_contentMap;
+	// destination path of a duplicate => destination path of the texture that is used instead
+	std::map<path, path> m_duplicateMap;
+	size_t m_numDuplicates = 0;
+	uint64_t m_duplicateBytesSaved = 0;
+	// only contains textures (destination path) with an alpha channel that is not fully opaque
+	std::map<path, ImageProbe::AlphaMode> m_alphaMap;
+	std::vector<Job> m_pending;
+	Settings m_settings;
+	std::shared_ptr<TextureCache> m_cache;
+	// identifies this converter in the destination claims of the cache (moves with the converter)
+	std::shared_ptr<const void> m_claimOwner = std::make_shared<char>();
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// output file of a 2D texture with mipmaps (largest mipmap is written first)
+class TextureWriter
+{
+public:
+	virtual ~TextureWriter() = default;
+
+	/// \brief writes the next mipmap
+	virtual void writeMipmap(const uint8_t* data, size_t size) = 0;
+	/// \brief returns the memory for the next mipmap. endMipmap() must be called after the data was written.
+	/// The default implementation uses a temporary buffer
+	virtual uint8_t* beginMipmap(size_t size)
+	{
+		m_buffer.resize(size);
+		return m_buffer.data();
+	}
+	virtual void endMipmap() { writeMipmap(m_buffer.data(), m_buffer.size()); }
+	/// \brief must be called after the last mipmap was written
+	virtual void finish() {}
+protected:
+	std::vector<uint8_t> m_buffer;
+};
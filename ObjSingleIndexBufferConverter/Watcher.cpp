@@ -0,0 +1,100 @@
+#include "Watcher.h"
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include "Console.h"
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+// editors write files in multiple steps => wait until they are done
+static constexpr auto s_debounceTime = std::chrono::milliseconds(300);
+
+Watcher::Watcher(const std::vector<path>& files)
+{
+	add(files, std::filesystem::file_time_type::max());
+
+	if (m_handles.empty())
+		throw std::runtime_error("no directory could be watched");
+}
+
+void Watcher::add(const std::vector<path>& files, std::filesystem::file_time_type since)
+{
+	for(const auto& f : files)
+	{
+		const auto file = std::filesystem::absolute(f);
+		if (m_files.count(file)) continue;
+		// files that were written after since are reported by the next wait()
+		m_files[file] = std::min(getWriteTime(file), since);
+		if (m_directories.insert(file.parent_path()).second)
+			watchDirectory(file.parent_path());
+	}
+}
+
+void Watcher::watchDirectory(const path& dir)
+{
+	if (m_handles.size() == MAXIMUM_WAIT_OBJECTS)
+	{
+		Console::warning("too many directories to watch, ignoring " + dir.string());
+		return;
+	}
+
+	auto handle = FindFirstChangeNotificationW(dir.wstring().c_str(), FALSE,
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		Console::warning("could not watch " + dir.string());
+		return;
+	}
+	m_handles.push_back(handle);
+}
+
+Watcher::~Watcher()
+{
+	for (auto h : m_handles)
+		FindCloseChangeNotification(h);
+}
+
+std::vector<Watcher::path> Watcher::wait()
+{
+	// changes of added files might have happened before their directory was watched
+	auto changed = findChanged();
+	if (!changed.empty()) return changed;
+
+	while(true)
+	{
+		const auto res = WaitForMultipleObjects(DWORD(m_handles.size()), m_handles.data(), FALSE, INFINITE);
+		if (res >= WAIT_OBJECT_0 + m_handles.size())
+			throw std::runtime_error("waiting for file changes failed");
+		FindNextChangeNotification(m_handles[res - WAIT_OBJECT_0]);
+
+		std::this_thread::sleep_for(s_debounceTime);
+
+		// the notification is for the whole directory => check the files
+		changed = findChanged();
+		if (!changed.empty()) return changed;
+	}
+}
+
+std::vector<Watcher::path> Watcher::findChanged()
+{
+	std::vector<path> changed;
+	for(auto& [file, time] : m_files)
+	{
+		const auto newTime = getWriteTime(file);
+		if (newTime == time) continue;
+		time = newTime;
+		changed.push_back(file);
+	}
+	return changed;
+}
+
+std::filesystem::file_time_type Watcher::getWriteTime(const path& file)
+{
+	std::error_code ec;
+	const auto time = std::filesystem::last_write_time(file, ec);
+	// missing files get the minimum time => creation is detected
+	if (ec) return std::filesystem::file_time_type::min();
+	return time;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+#include <map>
+#include <set>
+
+// waits for changes of files (directory change notifications of the os)
+class Watcher
+{
+public:
+	using path = std::filesystem::path;
+
+	/// \brief starts watching the directories of the files
+	explicit Watcher(const std::vector<path>& files);
+	~Watcher();
+	Watcher(const Watcher&) = delete;
+	Watcher& operator=(const Watcher&) = delete;
+
+	/// \brief watches additional files. Files that are already watched keep their state
+	/// \param since files that were written after this time count as changed
+	void add(const std::vector<path>& files, std::filesystem::file_time_type since);
+
+	/// \brief blocks until at least one of the files was modified, created or deleted since the watcher was created
+	/// \return all files that changed
+	std::vector<path> wait();
+private:
+	void watchDirectory(const path& dir);
+	/// \brief updates the write times and returns the files that changed
+	std::vector<path> findChanged();
+	static std::filesystem::file_time_type getWriteTime(const path& file);
+
+	// file => last write time
+	std::map<path, std::filesystem::file_time_type> m_files;
+	std::set<path> m_directories;
+	std::vector<void*> m_handles;
+};
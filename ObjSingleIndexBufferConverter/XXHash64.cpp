@@ -0,0 +1,153 @@
+#include "XXHash64.h"
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#include <stdexcept>
+
+namespace
+{
+	constexpr uint64_t s_prime1 = 11400714785074694791ull;
+	constexpr uint64_t s_prime2 = 14029467366897019727ull;
+	constexpr uint64_t s_prime3 = 1609587929392839161ull;
+	constexpr uint64_t s_prime4 = 9650029242287828579ull;
+	constexpr uint64_t s_prime5 = 2870177450012600261ull;
+
+	uint64_t rotl(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	uint64_t read64(const uint8_t* p)
+	{
+		uint64_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	uint32_t read32(const uint8_t* p)
+	{
+		uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	uint64_t round(uint64_t acc, uint64_t input)
+	{
+		acc += input * s_prime2;
+		acc = rotl(acc, 31);
+		return acc * s_prime1;
+	}
+
+	uint64_t mergeRound(uint64_t acc, uint64_t val)
+	{
+		acc ^= round(0, val);
+		return acc * s_prime1 + s_prime4;
+	}
+}
+
+XXHash64::XXHash64(uint64_t seed)
+	:
+m_seed(seed)
+{
+	m_acc[0] = seed + s_prime1 + s_prime2;
+	m_acc[1] = seed + s_prime2;
+	m_acc[2] = seed;
+	m_acc[3] = seed - s_prime1;
+}
+
+void XXHash64::update(const void* data, size_t size)
+{
+	auto p = static_cast<const uint8_t*>(data);
+	const auto end = p + size;
+	m_totalSize += size;
+
+	// fill the remaining stripe
+	if(m_bufferSize)
+	{
+		const size_t count = std::min(size, sizeof(m_buffer) - m_bufferSize);
+		std::memcpy(m_buffer + m_bufferSize, p, count);
+		m_bufferSize += count;
+		p += count;
+		if (m_bufferSize < sizeof(m_buffer)) return;
+
+		for (int i = 0; i < 4; ++i)
+			m_acc[i] = round(m_acc[i], read64(m_buffer + i * 8));
+		m_bufferSize = 0;
+	}
+
+	// full stripes
+	for(; p + 32 <= end; p += 32)
+	{
+		for (int i = 0; i < 4; ++i)
+			m_acc[i] = round(m_acc[i], read64(p + i * 8));
+	}
+
+	m_bufferSize = size_t(end - p);
+	std::memcpy(m_buffer, p, m_bufferSize);
+}
+
+uint64_t XXHash64::digest() const
+{
+	uint64_t h;
+	if(m_totalSize >= 32)
+	{
+		h = rotl(m_acc[0], 1) + rotl(m_acc[1], 7) + rotl(m_acc[2], 12) + rotl(m_acc[3], 18);
+		for (auto acc : m_acc)
+			h = mergeRound(h, acc);
+	}
+	else h = m_seed + s_prime5;
+
+	h += m_totalSize;
+
+	// remaining bytes
+	const uint8_t* p = m_buffer;
+	const auto end = m_buffer + m_bufferSize;
+	for(; p + 8 <= end; p += 8)
+	{
+		h ^= round(0, read64(p));
+		h = rotl(h, 27) * s_prime1 + s_prime4;
+	}
+	if(p + 4 <= end)
+	{
+		h ^= uint64_t(read32(p)) * s_prime1;
+		h = rotl(h, 23) * s_prime2 + s_prime3;
+		p += 4;
+	}
+	for(; p < end; ++p)
+	{
+		h ^= (*p) * s_prime5;
+		h = rotl(h, 11) * s_prime1;
+	}
+
+	// avalanche
+	h ^= h >> 33;
+	h *= s_prime2;
+	h ^= h >> 29;
+	h *= s_prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+uint64_t XXHash64::hash(const void* data, size_t size, uint64_t seed)
+{
+	XXHash64 h(seed);
+	h.update(data, size);
+	return h.digest();
+}
+
+uint64_t XXHash64::hashFile(const std::filesystem::path& filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("could not open " + filename.string());
+
+	XXHash64 h;
+	std::vector<char> buffer(1 << 20);
+	while(file)
+	{
+		file.read(buffer.data(), std::streamsize(buffer.size()));
+		h.update(buffer.data(), size_t(file.gcount()));
+	}
+	return h.digest();
+}
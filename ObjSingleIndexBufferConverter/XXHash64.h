@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+
+// streaming implementation of the xxHash64 (non-cryptographic) hash function
+class XXHash64
+{
+public:
+	explicit XXHash64(uint64_t seed = 0);
+
+	/// \brief adds data to the hash
+	void update(const void* data, size_t size);
+	/// \brief returns the hash of all data added so far
+	uint64_t digest() const;
+
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = 0);
+	/// \brief hashes the content of the file. throws if the file can not be read
+	static uint64_t hashFile(const std::filesystem::path& filename);
+private:
+	uint64_t m_acc[4];
+	uint8_t m_buffer[32];
+	size_t m_bufferSize = 0;
+	uint64_t m_totalSize = 0;
+	uint64_t m_seed;
+};
@@ -1,8 +1,18 @@
 #include "ArgumentSet.h"
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
 #include "Converter.h"
 #include "Console.h"
+#include "Batch.h"
+#include "Server.h"
+#include "Profiler.h"
 
+// input: obj file, optionally gzip compressed (e.g. scene.obj.gz, bgzip files are decompressed in parallel)
+//        or binary little endian ply file (materials from <name>.mtl, referenced by the face property material_index)
+//        or scene list (.json) whose inputs are loaded in parallel and merged into one scene with shared materials and textures:
+//        { "inputs": [ "a.obj", { "file": "b.obj", "translate": [x, y, z], "rotate": [x, y, z], "scale": s }, { "file": "c.ply", "matrix": [16 values, row major] } ] }
+//        relative paths are relative to the list, rotations are euler angles in degrees (x is applied first)
 // params: 
 // -notextures => skips texture conversion / generation
 // -singlefile => saves camera etc. in a single file
@@ -10,20 +20,39 @@
 // -nocamera => skips camera write
 // -nolight => skips light write
 // -noenv => skips env write
-// -nomesh => skips mesh generation
+// -nomesh => skips mesh generation (geometry is not parsed)
+// -nonormals => discards normals while parsing (flat normals are generated)
+// -notexcoords => discards texcoords while parsing
 // -transparent material1 material2 ... => forces materials to be seen as transparent (must be the material name)
 // -flipaxis axis1 axis2 .. => flips the position axes
-int main(int argc, char** argv) try
-{
-	if (argc < 3)
-		throw std::runtime_error("please provide input obj as first parameter and output file as second parameter");
-	std::string inputFilename = argv[1];
-	std::string outputFilename = argv[2];
+// -noalphatest => materials with binary albedo alpha go to the transparent mesh instead of a separate alpha tested mesh
+// -compress [fast|normal|high] => block compresses textures in-process (BC1 opaque, BC3/BC7 alpha, BC5 normals)
+// -maxtexsize N => downscales textures whose longest side is larger than N
+// -texbudget role1 N1 role2 N2 ... => maximum size for the texture roles albedo, coverage, specular, normal and packed
+// -texeldensity D => skips top mipmaps that exceed D texels per world unit (based on the mesh uv density)
+// -ktx2 [zlib|none] => writes textures as ktx2 with optional zlib supercompression (default zlib). Use with -compress for BCn
+// -nomergematerials => keeps materials that only differ in their name
+// -emitters => writes all emissive triangles with a power based alias table to <output>.emitters
+// -nopacking => roughness, metalness, occlusion and specular maps are not packed into one texture
+// -objcache => stores the parsed obj in <input>.objcache and reuses it while the obj and mtl files are unchanged
+// -stream [budgetMB] => converts shapes while parsing and keeps them in a temporary file. Fails if the estimated memory exceeds the budget (default unlimited).
+//                       no texture atlases, material merging, emitters or texel density
+// -watch => keeps running and converts the scene again when the obj, mtl or texture files change
+// -atlas [size] => packs small albedo-only textures into atlas pages of the given size (default 2048)
+// -profile out.json => prints the duration and peak memory of each stage and writes a chrome trace (chrome://tracing) with one lane per thread
+// batch mode: -batch jobs.json [-threads N] [-profile out.json]
+// jobs.json: { "jobs": [ { "input": "a.obj", "output": "out/a", "flags": "-compress high" }, ... ] }
+// relative paths are relative to jobs.json. All jobs run in one process with a shared texture cache
+// server mode: -serve socket [-threads N] => accepts jobs over a unix domain socket until shutdown
+// requests (one json per line): { "input": "a.obj", "output": "out/a", "flags": "-compress", "priority": 0 } or { "command": "shutdown" }
+// events (one json per line): queued, started, info, warning, error, progress and finished (with "success") for each "job" id.
+// higher priorities run first, texture caches stay loaded between jobs
 
+// applies the params to the converter
+static void configure(Converter& converter, int argc, char** argv)
+{
 	util::ArgumentSet args;
-	args.init(argc - 3, argv + 3);
-
-	Converter converter;
+	args.init(argc, argv);
 
 	if (args.has("notextures") || args.has("nomaterial"))
 		converter.GenerateTextures = false;
@@ -35,10 +64,86 @@ int main(int argc, char** argv) try
 		converter.removeComponent(hrsf::Component::Camera);
 	if (args.has("noenv"))
 		converter.removeComponent(hrsf::Component::Environment);
+	if (args.has("nonormals"))
+		converter.UseNormals = false;
+	if (args.has("notexcoords"))
+		converter.UseTexcoords = false;
 	if (args.has("nomesh"))
 		converter.removeComponent(hrsf::Component::Mesh);
 	if (args.has("nolight"))
 		converter.removeComponent(hrsf::Component::Lights);
+	if (args.has("noalphatest"))
+		converter.SeparateAlphaTest = false;
+	if(args.has("compress"))
+	{
+		converter.CompressTextures = true;
+		// a bare -compress is stored as "true"
+		const auto quality = args.get<std::string>("compress", "normal");
+		if (quality == "fast")
+			converter.TextureQuality = BlockCompression::Quality::Fast;
+		else if (quality == "high")
+			converter.TextureQuality = BlockCompression::Quality::High;
+		else if (quality == "normal" || quality == "true")
+			converter.TextureQuality = BlockCompression::Quality::Normal;
+		else
+			throw std::runtime_error("unknown compression quality " + quality + " (expected fast, normal or high)");
+	}
+	if(args.has("ktx2"))
+	{
+		converter.UseKtx2 = true;
+		// a bare -ktx2 is stored as "true"
+		const auto supercompression = args.get<std::string>("ktx2", "zlib");
+		if (supercompression == "zlib" || supercompression == "true")
+			converter.SupercompressTextures = true;
+		else if (supercompression == "none")
+			converter.SupercompressTextures = false;
+		else
+			throw std::runtime_error("unknown ktx2 supercompression " + supercompression + " (expected zlib or none)");
+	}
+	if (args.has("nomergematerials"))
+		converter.MergeMaterials = false;
+	if (args.has("emitters"))
+		converter.ExtractEmitters = true;
+	if (args.has("nopacking"))
+		converter.PackChannels = false;
+	if (args.has("objcache"))
+		converter.UseObjCache = true;
+	if(args.has("stream"))
+	{
+		converter.StreamShapes = true;
+		converter.MemoryBudget = args.get<int>("stream", 0);
+	}
+	if (args.has("maxtexsize"))
+		converter.MaxTextureSize = args.get<int>("maxtexsize", 0);
+	if(args.has("texbudget"))
+	{
+		auto budgets = args.getVector<std::string>("texbudget");
+		if (budgets.size() % 2 != 0) throw std::runtime_error("texbudget expects pairs of role and size");
+		for(size_t i = 0; i < budgets.size(); i += 2)
+		{
+			const auto& value = budgets[i + 1];
+			char* end = nullptr;
+			const long size = std::strtol(value.c_str(), &end, 10);
+			if (value.empty() || *end != '\0' || size < 0 || size > (1 << 16))
+				throw std::runtime_error("texbudget: invalid size " + value + " for role " + budgets[i]);
+			converter.setTextureBudget(budgets[i], int(size));
+		}
+	}
+	if (args.has("texeldensity"))
+		converter.TexelDensity = args.get<float>("texeldensity", 0.0f);
+	if(args.has("atlas"))
+	{
+		// a bare -atlas is stored as "true"
+		const auto size = args.get<std::string>("atlas", "true");
+		converter.AtlasSize = 2048;
+		if(size != "true")
+		{
+			const int value = std::atoi(size.c_str());
+			if (value <= 0 || (value & (value - 1)) != 0)
+				throw std::runtime_error("atlas size must be a power of two (got " + size + ")");
+			converter.AtlasSize = value;
+		}
+	}
 	if(args.has("transparent"))
 	{
 		auto names = args.getVector<std::string>("transparent");
@@ -54,9 +159,71 @@ int main(int argc, char** argv) try
 		converter.setAxisFlips(move(swaps));
 	}
 
+}
+
+// trace file of -profile (a bare -profile is stored as "true")
+static std::string getProfileFile(const util::ArgumentSet& args)
+{
+	const auto file = args.get<std::string>("profile", "profile.json");
+	if (file == "true") return "profile.json";
+	return file;
+}
+
+int main(int argc, char** argv) try
+{
+	if(argc >= 3 && std::string(argv[1]) == "-batch")
+	{
+		util::ArgumentSet args;
+		args.init(argc - 3, argv + 3);
+
+		if (args.has("profile"))
+			Profiler::setEnabled(true);
+
+		Batch batch(argv[2]);
+		const auto failed = batch.run(configure, size_t(std::max(args.get<int>("threads", 0), 0)));
+		if(args.has("profile"))
+		{
+			Profiler::printStages();
+			Profiler::writeTrace(getProfileFile(args));
+		}
+		return failed ? -1 : 0;
+	}
+
+	if(argc >= 3 && std::string(argv[1]) == "-serve")
+	{
+		util::ArgumentSet args;
+		args.init(argc - 3, argv + 3);
+
+		Server server(argv[2]);
+		server.run(configure, size_t(std::max(args.get<int>("threads", 0), 0)));
+		return 0;
+	}
+
+	if (argc < 3)
+		throw std::runtime_error("please provide input obj as first parameter and output file as second parameter");
+	std::string inputFilename = argv[1];
+	std::string outputFilename = argv[2];
+
+	Converter converter;
+	configure(converter, argc - 3, argv + 3);
+
+	util::ArgumentSet args;
+	args.init(argc - 3, argv + 3);
+	if (args.has("watch"))
+		converter.watch(inputFilename, outputFilename); // does not return
+
+	if (args.has("profile"))
+		Profiler::setEnabled(true);
+
 	converter.convert(inputFilename, outputFilename);
 	converter.printStats();
 
+	if(args.has("profile"))
+	{
+		Profiler::printStages();
+		Profiler::writeTrace(getProfileFile(args));
+	}
+
 	return 0;
 }
 catch (const std::exception& e)